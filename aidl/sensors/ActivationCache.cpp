@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ActivationCache.h"
+
+#include "Clock.h"
+#include "SensorRegistry.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+static size_t getSubHalIndex(int32_t sensorHandle) {
+    return static_cast<uint32_t>(sensorHandle) >> SensorRegistry::kBitsAfterSubHalIndex;
+}
+
+SensorActivation* ActivationCache::beginCall(int32_t sensorHandle, Call* call) {
+    call->startNs = getMonotonicTimeNs();
+    if (mUncached.count(sensorHandle) > 0) {
+        // Leaves nothing for endCall() to update.
+        call->generation = 0;
+        return nullptr;
+    }
+    SensorActivation& activation = mSensors[sensorHandle];
+    call->generation = ++activation.generation;
+    return &activation;
+}
+
+bool ActivationCache::endCall(int32_t sensorHandle, const Call& call,
+                              SensorActivation** activation) {
+    int64_t durationNs = getMonotonicTimeNs() - call.startNs;
+    SubHalCallStats& stats = mSubHalStats[getSubHalIndex(sensorHandle)];
+    stats.numCalls++;
+    stats.totalNs += durationNs;
+    stats.maxNs = std::max(stats.maxNs, durationNs);
+
+    auto it = mSensors.find(sensorHandle);
+    if (it == mSensors.end() || it->second.generation != call.generation) {
+        return false;
+    }
+    *activation = &it->second;
+    return true;
+}
+
+bool ActivationCache::beginActivate(int32_t sensorHandle, bool enabled, Call* call) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mSensors.find(sensorHandle);
+    if (it != mSensors.end() && it->second.isActivationKnown && it->second.enabled == enabled) {
+        numActivateSuppressed++;
+        return false;
+    }
+    SensorActivation* activation = beginCall(sensorHandle, call);
+    if (activation != nullptr) {
+        activation->isActivationKnown = false;
+        if (!enabled) {
+            activation->isBatchKnown = false;
+        }
+    }
+    return true;
+}
+
+void ActivationCache::endActivate(int32_t sensorHandle, bool enabled, const Call& call,
+                                  bool success) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    SensorActivation* activation;
+    if (!endCall(sensorHandle, call, &activation)) {
+        return;
+    }
+    activation->isActivationKnown = success;
+    activation->enabled = enabled;
+}
+
+bool ActivationCache::beginBatch(int32_t sensorHandle, int64_t samplingPeriodNs,
+                                 int64_t maxReportLatencyNs, Call* call) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mSensors.find(sensorHandle);
+    if (it != mSensors.end() && it->second.isBatchKnown &&
+        it->second.samplingPeriodNs == samplingPeriodNs &&
+        it->second.maxReportLatencyNs == maxReportLatencyNs) {
+        numBatchSuppressed++;
+        return false;
+    }
+    SensorActivation* activation = beginCall(sensorHandle, call);
+    if (activation != nullptr) {
+        activation->isBatchKnown = false;
+    }
+    return true;
+}
+
+void ActivationCache::endBatch(int32_t sensorHandle, int64_t samplingPeriodNs,
+                               int64_t maxReportLatencyNs, const Call& call, bool success) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    SensorActivation* activation;
+    if (!endCall(sensorHandle, call, &activation)) {
+        return;
+    }
+    activation->isBatchKnown = success;
+    activation->samplingPeriodNs = samplingPeriodNs;
+    activation->maxReportLatencyNs = maxReportLatencyNs;
+}
+
+void ActivationCache::setUncached(int32_t sensorHandle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mUncached.insert(sensorHandle);
+    mSensors.erase(sensorHandle);
+}
+
+void ActivationCache::forget(int32_t sensorHandle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSensors.erase(sensorHandle);
+    mUncached.erase(sensorHandle);
+}
+
+void ActivationCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSensors.clear();
+}
+
+void ActivationCache::dump(std::ostream& stream) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t numEnabled = std::count_if(mSensors.begin(), mSensors.end(), [](const auto& entry) {
+        return entry.second.isActivationKnown && entry.second.enabled;
+    });
+    stream << "  # of enabled sensors: " << numEnabled << std::endl;
+    stream << "  # of suppressed activate calls: " << numActivateSuppressed << std::endl;
+    stream << "  # of suppressed batch calls: " << numBatchSuppressed << std::endl;
+}
+
+void ActivationCache::dumpSubHal(std::ostream& stream, size_t subHalIndex) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mSubHalStats.find(subHalIndex);
+    if (it == mSubHalStats.end() || it->second.numCalls == 0) {
+        stream << "  activate/batch calls: 0" << std::endl;
+        return;
+    }
+    const SubHalCallStats& stats = it->second;
+    int64_t averageNs = stats.totalNs / static_cast<int64_t>(stats.numCalls);
+    stream << "  activate/batch calls: " << stats.numCalls << ", average latency: "
+           << averageNs / kNsPerUs << " us, max latency: " << stats.maxNs / kNsPerUs << " us"
+           << std::endl;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Last state successfully set on a sub-HAL for a sensor.
+ */
+struct SensorActivation {
+    bool isActivationKnown = false;
+    bool enabled = false;
+    bool isBatchKnown = false;
+    int64_t samplingPeriodNs = 0;
+    int64_t maxReportLatencyNs = 0;
+    // Bumped by every forwarded call, so that a call that completes after a newer one was
+    // started does not overwrite what the newer one set.
+    uint64_t generation = 0;
+};
+
+struct SubHalCallStats {
+    uint64_t numCalls = 0;
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+};
+
+/**
+ * Remembers what activate() and batch() last set on each sensor so that calls which would not
+ * change anything never reach the sub-HAL.
+ *
+ * Only successful calls are remembered and deactivating a sensor forgets its batch parameters,
+ * so a sub-HAL that resets them on deactivation still gets them again. One-shot sensors disable
+ * themselves when they trigger, without a call that the cache could see, so their calls always
+ * go through.
+ */
+class ActivationCache {
+  public:
+    struct Call {
+        uint64_t generation = 0;
+        int64_t startNs = 0;
+    };
+
+    /**
+     * @return false if the sensor already is in the requested state and the call can be skipped.
+     */
+    bool beginActivate(int32_t sensorHandle, bool enabled, Call* call);
+    void endActivate(int32_t sensorHandle, bool enabled, const Call& call, bool success);
+
+    /**
+     * @return false if the sensor already uses these parameters and the call can be skipped.
+     */
+    bool beginBatch(int32_t sensorHandle, int64_t samplingPeriodNs, int64_t maxReportLatencyNs,
+                    Call* call);
+    void endBatch(int32_t sensorHandle, int64_t samplingPeriodNs, int64_t maxReportLatencyNs,
+                  const Call& call, bool success);
+
+    /**
+     * Never skip calls for a sensor, e.g. because it is one-shot. Survives clear().
+     */
+    void setUncached(int32_t sensorHandle);
+
+    /**
+     * Forget the state of a sensor, e.g. a dynamic sensor that was disconnected.
+     */
+    void forget(int32_t sensorHandle);
+
+    /**
+     * Forget everything, for when the sub-HALs may have reset their sensors.
+     */
+    void clear();
+
+    void dump(std::ostream& stream);
+
+    /**
+     * Print the activate() and batch() latency of a sub-HAL.
+     */
+    void dumpSubHal(std::ostream& stream, size_t subHalIndex);
+
+    std::atomic<uint64_t> numActivateSuppressed = 0;
+    std::atomic<uint64_t> numBatchSuppressed = 0;
+
+  private:
+    SensorActivation* beginCall(int32_t sensorHandle, Call* call);
+    bool endCall(int32_t sensorHandle, const Call& call, SensorActivation** activation);
+
+    std::mutex mMutex;
+    std::unordered_map<int32_t, SensorActivation> mSensors;
+    std::unordered_set<int32_t> mUncached;
+    std::map<size_t, SubHalCallStats> mSubHalStats;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -7,22 +7,19 @@
 #include "AlsCorrection.h"
 
 #include <android-base/properties.h>
-#include <android/binder_manager.h>
-#include <binder/IBinder.h>
-#include <binder/IServiceManager.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <log/log.h>
+#include <sstream>
+#include <thread>
 #include <utils/Timers.h>
 
-using aidl::vendor::lineage::oplus_als::AreaRgbCaptureResult;
-using aidl::vendor::lineage::oplus_als::IAreaCapture;
 using android::base::GetBoolProperty;
 using android::base::GetIntProperty;
 using android::base::GetProperty;
 
 #define ALS_CALI_DIR "/proc/sensor/als_cali/"
-#define BRIGHTNESS_DIR "/sys/class/backlight/panel0-backlight/"
 
 namespace android {
 namespace hardware {
@@ -30,32 +27,17 @@ namespace sensors {
 namespace V2_1 {
 namespace implementation {
 
-static const std::string rgbw_max_lux_paths[4] = {
-    ALS_CALI_DIR "red_max_lux",
-    ALS_CALI_DIR "green_max_lux",
-    ALS_CALI_DIR "blue_max_lux",
-    ALS_CALI_DIR "white_max_lux",
+static const char* const rgbw_max_lux_names[4] = {
+    "red_max_lux",
+    "green_max_lux",
+    "blue_max_lux",
+    "white_max_lux",
 };
 
-struct als_config {
-    bool hbr;
-    float rgbw_max_lux[4];
-    float rgbw_max_lux_div[4];
-    float rgbw_lux_postmul[4];
-    float rgbw_poly[4][4];
-    float grayscale_weights[3];
-    float sensor_gaincal_points[4];
-    float sensor_inverse_gain[4];
-    float agc_threshold;
-    float calib_gain;
-    float bias;
-    float max_brightness;
-};
-
-static struct {
+static const struct {
     float middle;
     float min, max;
-} hysteresis_ranges[] = {
+} default_hysteresis_ranges[] = {
     { 0, 0, 4 },
     { 7, 1, 12 },
     { 15, 5, 30 },
@@ -68,22 +50,6 @@ static struct {
     { HUGE_VALF, 8000, HUGE_VALF },
 };
 
-static struct {
-    nsecs_t last_update, last_forced_update;
-    bool force_update;
-    float hyst_min, hyst_max;
-    float last_corrected_value;
-    float last_agc_gain;
-} state = {
-    .last_update = 0,
-    .force_update = true,
-    .hyst_min = -1.0, .hyst_max = -1.0,
-    .last_agc_gain = 0.0,
-};
-
-static als_config conf;
-static std::shared_ptr<IAreaCapture> service;
-
 template <typename T>
 static T get(const std::string& path, const T& def) {
     std::ifstream file(path);
@@ -93,205 +59,269 @@ static T get(const std::string& path, const T& def) {
     return file.fail() ? def : result;
 }
 
-static float cached_event = 0.0f;
+AlsCorrection::AlsCorrection(const std::string& name, const std::string& propertyPrefix,
+                             std::shared_ptr<AlsScreen> screen)
+    : mName(name),
+      mPropertyPrefix(propertyPrefix.empty() ? kDefaultPropertyPrefix : propertyPrefix),
+      mScreen(std::move(screen)) {}
 
-void AlsCorrection::init() {
-    std::istringstream is;
+AlsCorrection::~AlsCorrection() {
+    mStopping.store(true);
+    if (mInitThread.joinable()) {
+        mInitThread.join();
+    }
+}
+
+void AlsCorrection::start() {
+    if (mStarted.exchange(true)) {
+        return;
+    }
+    mInitThread = std::thread([this] {
+        if (init()) {
+            mReady.store(true, std::memory_order_release);
+        }
+    });
+}
+
+bool AlsCorrection::isReady() const {
+    return mReady.load(std::memory_order_acquire);
+}
 
-    conf.hbr = GetBoolProperty("vendor.sensors.als_correction.hbr", false);
-    conf.bias = GetIntProperty("vendor.sensors.als_correction.bias", 0);
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_max_lux_div", ""));
-    is >> conf.rgbw_max_lux_div[0] >> conf.rgbw_max_lux_div[1]
-        >> conf.rgbw_max_lux_div[2] >> conf.rgbw_max_lux_div[3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_poly1", ""));
-    is >> conf.rgbw_poly[0][0] >> conf.rgbw_poly[0][1]
-        >> conf.rgbw_poly[0][2] >> conf.rgbw_poly[0][3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_poly2", ""));
-    is >> conf.rgbw_poly[1][0] >> conf.rgbw_poly[1][1]
-        >> conf.rgbw_poly[1][2] >> conf.rgbw_poly[1][3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_poly3", ""));
-    is >> conf.rgbw_poly[2][0] >> conf.rgbw_poly[2][1]
-        >> conf.rgbw_poly[2][2] >> conf.rgbw_poly[2][3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_poly4", ""));
-    is >> conf.rgbw_poly[3][0] >> conf.rgbw_poly[3][1]
-        >> conf.rgbw_poly[3][2] >> conf.rgbw_poly[3][3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.grayscale_weights", ""));
-    is >> conf.grayscale_weights[0] >> conf.grayscale_weights[1] >> conf.grayscale_weights[2];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.sensor_gaincal_points", ""));
-    is >> conf.sensor_gaincal_points[0] >> conf.sensor_gaincal_points[1]
-        >> conf.sensor_gaincal_points[2] >> conf.sensor_gaincal_points[3];
-    is = std::istringstream(GetProperty("vendor.sensors.als_correction.sensor_inverse_gain", ""));
-    is >> conf.sensor_inverse_gain[0] >> conf.sensor_inverse_gain[1]
-        >> conf.sensor_inverse_gain[2] >> conf.sensor_inverse_gain[3];
+std::string AlsCorrection::getPropertyName(const char* key) const {
+    return mPropertyPrefix + "." + key;
+}
+
+bool AlsCorrection::init() {
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::istringstream is;
 
+    mConfig.hbr = GetBoolProperty(getPropertyName("hbr"), false);
+    mConfig.bias = GetIntProperty(getPropertyName("bias"), 0);
+    mConfig.min_interval = ms2ns(GetIntProperty(getPropertyName("min_interval_ms"), 100));
+    mConfig.on_change_only = GetBoolProperty(getPropertyName("on_change_only"), false);
+    is = std::istringstream(GetProperty(getPropertyName("rgbw_max_lux_div"), ""));
+    is >> mConfig.rgbw_max_lux_div[0] >> mConfig.rgbw_max_lux_div[1]
+        >> mConfig.rgbw_max_lux_div[2] >> mConfig.rgbw_max_lux_div[3];
+    for (int i = 0; i < 4; i++) {
+        is = std::istringstream(
+                GetProperty(getPropertyName(("rgbw_poly" + std::to_string(i + 1)).c_str()), ""));
+        is >> mConfig.rgbw_poly[i][0] >> mConfig.rgbw_poly[i][1]
+            >> mConfig.rgbw_poly[i][2] >> mConfig.rgbw_poly[i][3];
+    }
+    is = std::istringstream(GetProperty(getPropertyName("grayscale_weights"), ""));
+    is >> mConfig.grayscale_weights[0] >> mConfig.grayscale_weights[1]
+        >> mConfig.grayscale_weights[2];
+    is = std::istringstream(GetProperty(getPropertyName("sensor_gaincal_points"), ""));
+    is >> mConfig.sensor_gaincal_points[0] >> mConfig.sensor_gaincal_points[1]
+        >> mConfig.sensor_gaincal_points[2] >> mConfig.sensor_gaincal_points[3];
+    is = std::istringstream(GetProperty(getPropertyName("sensor_inverse_gain"), ""));
+    is >> mConfig.sensor_inverse_gain[0] >> mConfig.sensor_inverse_gain[1]
+        >> mConfig.sensor_inverse_gain[2] >> mConfig.sensor_inverse_gain[3];
+
+    // Each sensor has its own calibration, the default directory is the one of the front sensor.
+    std::string cali_dir = GetProperty(getPropertyName("cali_dir"), ALS_CALI_DIR);
     float rgbw_acc = 0.0;
     for (int i = 0; i < 4; i++) {
-        float max_lux = get(rgbw_max_lux_paths[i], 0.0);
+        float max_lux = get(cali_dir + rgbw_max_lux_names[i], 0.0);
         if (max_lux != 0.0) {
-            conf.rgbw_max_lux[i] = max_lux;
+            mConfig.rgbw_max_lux[i] = max_lux;
         }
         if (i < 3) {
-            rgbw_acc += conf.rgbw_max_lux[i];
-            conf.rgbw_lux_postmul[i] = conf.rgbw_max_lux[i] / conf.rgbw_max_lux_div[i];
+            rgbw_acc += mConfig.rgbw_max_lux[i];
+            mConfig.rgbw_lux_postmul[i] = mConfig.rgbw_max_lux[i] / mConfig.rgbw_max_lux_div[i];
         } else {
-            rgbw_acc -= conf.rgbw_max_lux[i];
-            conf.rgbw_lux_postmul[i] = rgbw_acc / conf.rgbw_max_lux_div[i];
+            rgbw_acc -= mConfig.rgbw_max_lux[i];
+            mConfig.rgbw_lux_postmul[i] = rgbw_acc / mConfig.rgbw_max_lux_div[i];
         }
     }
-    ALOGI("Display maximums: R=%.0f G=%.0f B=%.0f W=%.0f",
-        conf.rgbw_max_lux[0], conf.rgbw_max_lux[1],
-        conf.rgbw_max_lux[2], conf.rgbw_max_lux[3]);
+    ALOGI("%s: display maximums: R=%.0f G=%.0f B=%.0f W=%.0f", mName.c_str(),
+        mConfig.rgbw_max_lux[0], mConfig.rgbw_max_lux[1],
+        mConfig.rgbw_max_lux[2], mConfig.rgbw_max_lux[3]);
 
-    float row_coe = get(ALS_CALI_DIR "row_coe", 0.0);
+    float row_coe = get(cali_dir + "row_coe", 0.0);
     if (row_coe != 0.0) {
-        conf.sensor_inverse_gain[0] = row_coe / 1000.0;
+        mConfig.sensor_inverse_gain[0] = row_coe / 1000.0;
     }
-    conf.agc_threshold = 800.0 / conf.sensor_inverse_gain[0];
-
-    float cali_coe = get(ALS_CALI_DIR "cali_coe", 0.0);
-    conf.calib_gain = cali_coe > 0.0 ? cali_coe / 1000.0 : 1.0;
-    ALOGI("Calibrated sensor gain: %.2fx", 1.0 / (conf.calib_gain * conf.sensor_inverse_gain[0]));
-
-    conf.max_brightness = get(BRIGHTNESS_DIR "max_brightness", 1023.0);
-
-    for (auto& range : hysteresis_ranges) {
-        range.min /= conf.calib_gain * conf.sensor_inverse_gain[0];
-        range.max /= conf.calib_gain * conf.sensor_inverse_gain[0];
+    mConfig.agc_threshold = 800.0 / mConfig.sensor_inverse_gain[0];
+
+    float cali_coe = get(cali_dir + "cali_coe", 0.0);
+    mConfig.calib_gain = cali_coe > 0.0 ? cali_coe / 1000.0 : 1.0;
+    ALOGI("%s: calibrated sensor gain: %.2fx", mName.c_str(),
+        1.0 / (mConfig.calib_gain * mConfig.sensor_inverse_gain[0]));
+
+    for (const auto& range : default_hysteresis_ranges) {
+        mHysteresisRanges.push_back({
+            range.middle,
+            range.min / (mConfig.calib_gain * mConfig.sensor_inverse_gain[0]),
+            range.max / (mConfig.calib_gain * mConfig.sensor_inverse_gain[0]),
+        });
     }
-    hysteresis_ranges[0].min = -1.0;
-
-    const auto instancename = std::string(IAreaCapture::descriptor) + "/default";
+    mHysteresisRanges[0].min = -1.0;
 
-    if (AServiceManager_isDeclared(instancename.c_str())) {
-        service = IAreaCapture::fromBinder(::ndk::SpAIBinder(
-            AServiceManager_waitForService(instancename.c_str())));
-    } else {
-        ALOGE("Service is not registered");
+    if (mStopping.load()) {
+        return false;
     }
+    // Also waits for the area capture service, the first time around.
+    mScreen->connect();
+    mConfig.max_brightness = mScreen->getMaxBrightness();
+    mModel.init(mConfig.rgbw_poly, mConfig.rgbw_lux_postmul, mConfig.grayscale_weights,
+                mConfig.rgbw_max_lux[3], mConfig.max_brightness);
+
+    mConfigTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    return true;
 }
 
-void AlsCorrection::process(Event& event) {
-    static AreaRgbCaptureResult screenshot = { 0.0, 0.0, 0.0 };
-
+/**
+ * @return false if the event should be dropped.
+ */
+bool AlsCorrection::correct(Event& event) {
     ALOGV("Raw sensor reading: %.0f", event.u.scalar);
 
-    if (event.u.scalar > conf.bias) {
-        event.u.scalar -= conf.bias;
+    if (event.u.scalar > mConfig.bias) {
+        event.u.scalar -= mConfig.bias;
     }
 
     nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
-    float brightness = get(BRIGHTNESS_DIR "brightness", 0.0);
+    // The brightness the panel had when the sample was taken, not when it got here.
+    float brightness = mScreen->getBrightness(event.timestamp);
 
-    if (state.last_update == 0) {
-        state.last_update = now;
-        state.last_forced_update = now;
+    if (mState.last_update == 0) {
+        mState.last_update = now;
+        mState.last_forced_update = now;
     } else {
-        if (brightness > 0.0 && (now - state.last_forced_update) > s2ns(3)) {
+        if (brightness > 0.0 && (now - mState.last_forced_update) > s2ns(3)) {
             ALOGV("Forcing screenshot");
-            state.last_forced_update = now;
-            state.force_update = true;
+            mState.last_forced_update = now;
+            mState.force_update = true;
         }
-        if ((now - state.last_update) < ms2ns(100)) {
+        if ((now - mState.last_update) < mConfig.min_interval) {
             ALOGV("Events coming too fast, dropping");
-            // TODO figure out a better way to drop events
-            event.sensorHandle = 0;
-            return;
+            mDroppedTooFast++;
+            return false;
         }
-        state.last_update = now;
+        mState.last_update = now;
     }
 
-    float sensor_raw_calibrated = event.u.scalar * conf.calib_gain * state.last_agc_gain;
-    if (state.force_update
-            || ((event.u.scalar < state.hyst_min || event.u.scalar > state.hyst_max)
-                && (sensor_raw_calibrated < 10.0 || sensor_raw_calibrated > (5.0 / .07)))) {
-
-        if (service == nullptr || !service->getAreaBrightness(&screenshot).isOk()) {
-            ALOGE("Could not get area above sensor");
-            // TODO figure out a better way to drop events
-            event.sensorHandle = 0;
-            return;
-        }
-
-        if (screenshot.r + screenshot.g + screenshot.b == 0) {
-            cached_event = event.u.scalar;
-            return;
+    float sensor_raw_calibrated = event.u.scalar * mConfig.calib_gain * mState.last_agc_gain;
+    bool needs_capture = mState.force_update
+            || ((event.u.scalar < mState.hyst_min || event.u.scalar > mState.hyst_max)
+                && (sensor_raw_calibrated < 10.0 || sensor_raw_calibrated > (5.0 / .07)));
+    if (needs_capture) {
+        // A capture is a full screenshot, so never wait for one here. Correct with the latest
+        // capture and have the worker take a new one, which a following event picks up.
+        mScreen->requestCapture();
+    }
+    if (needs_capture || mScreen->getGeneration() != mState.capture_generation) {
+        AreaRgbCaptureResult screenshot;
+        nsecs_t capture_time;
+        if (!mScreen->getLatestCapture(&screenshot, &capture_time, &mState.capture_generation)) {
+            mDroppedNoCapture++;
+            return false;
         }
+        mCaptureAgeMs.record(ns2ms(now - capture_time));
 
         ALOGV("Screen color above sensor: %f %f %f", screenshot.r, screenshot.g, screenshot.b);
-        // I give up.
-        event.u.scalar = cached_event;
-        return;
-        float rgbw[4] = {
-            screenshot.r, screenshot.g, screenshot.b,
-            screenshot.r * conf.grayscale_weights[0]
-                + screenshot.g * conf.grayscale_weights[1]
-                + screenshot.b * conf.grayscale_weights[2]
-        };
-        float cumulative_correction = 0.0;
-        for (int i = 0; i < 4; i++) {
-            float corr = 0.0;
-            for (float coef : conf.rgbw_poly[i]) {
-                corr *= rgbw[i];
-                corr += coef;
-            }
-            corr *= conf.rgbw_lux_postmul[i];
-            if (i < 3) {
-                cumulative_correction += std::max(corr, 0.0f);
-            } else {
-                cumulative_correction -= corr;
-            }
+        // A black area adds no light, whatever the fitted polynomials say at 0.
+        float cumulative_correction = 0.0f;
+        if (screenshot.r + screenshot.g + screenshot.b != 0) {
+            cumulative_correction =
+                    mModel.getScreenLux(screenshot.r, screenshot.g, screenshot.b, brightness);
         }
-        cumulative_correction *= brightness / conf.max_brightness;
-        float brightness_fullwhite = conf.rgbw_max_lux[3] * brightness / conf.max_brightness;
-        float brightness_grayscale_gamma = std::pow(rgbw[3] / 255.0, 2.2) * brightness_fullwhite;
-        cumulative_correction = std::min(cumulative_correction, brightness_fullwhite);
-        cumulative_correction = std::max(cumulative_correction, brightness_grayscale_gamma);
+        float brightness_fullwhite =
+                mConfig.rgbw_max_lux[3] * brightness / mConfig.max_brightness;
         ALOGV("Estimated screen brightness: %.0f", cumulative_correction);
 
         float sensor_raw_corrected = std::max(event.u.scalar - cumulative_correction, 0.0f);
 
-        float agc_gain = conf.sensor_inverse_gain[0];
-        if (sensor_raw_corrected > conf.agc_threshold) {
+        float agc_gain = mConfig.sensor_inverse_gain[0];
+        if (sensor_raw_corrected > mConfig.agc_threshold) {
             float gain_estimate = 0;
-            if (conf.hbr) {
+            if (mConfig.hbr) {
                 gain_estimate = event.u.data[2] * 1000.0 / sensor_raw_corrected;
             } else {
                 gain_estimate = sensor_raw_corrected / event.u.data[2];
             }
             for (int i = 0; i < 4; i++) {
-                if (gain_estimate > conf.sensor_gaincal_points[i]) {
-                    agc_gain = conf.sensor_inverse_gain[i];
+                if (gain_estimate > mConfig.sensor_gaincal_points[i]) {
+                    agc_gain = mConfig.sensor_inverse_gain[i];
                 }
             }
         }
         ALOGV("AGC gain: %f", agc_gain);
 
         if (cumulative_correction <= event.u.scalar * 1.35
-                || event.u.scalar * conf.calib_gain * agc_gain < 10000.0
-                || state.force_update) {
-            float sensor_corrected = sensor_raw_corrected * conf.calib_gain * agc_gain;
-            state.last_agc_gain = agc_gain;
-            for (auto& range : hysteresis_ranges) {
+                || event.u.scalar * mConfig.calib_gain * agc_gain < 10000.0
+                || mState.force_update) {
+            float sensor_corrected = sensor_raw_corrected * mConfig.calib_gain * agc_gain;
+            mState.last_agc_gain = agc_gain;
+            for (const auto& range : mHysteresisRanges) {
                 if (sensor_corrected <= range.middle) {
-                    state.hyst_min = range.min;
-                    state.hyst_max = range.max + brightness_fullwhite;
+                    mState.hyst_min = range.min;
+                    mState.hyst_max = range.max + brightness_fullwhite;
                     break;
                 }
             }
             sensor_corrected = std::max(sensor_corrected - 14.0, 0.0);
             event.u.scalar = sensor_corrected;
-            state.last_corrected_value = sensor_corrected;
+            mState.last_corrected_value = sensor_corrected;
             ALOGV("Fully corrected sensor value: %.0f lux", sensor_corrected);
         } else {
-            event.u.scalar = state.last_corrected_value;
+            event.u.scalar = mState.last_corrected_value;
             ALOGV("Reusing cached value: %.0f lux", event.u.scalar);
+            mReusedValues++;
         }
 
-        state.force_update = false;
+        mState.force_update = false;
     } else {
-        event.u.scalar = state.last_corrected_value;
+        event.u.scalar = mState.last_corrected_value;
         ALOGV("Reusing cached value: %.0f lux", event.u.scalar);
+        mReusedValues++;
+    }
+    return true;
+}
+
+bool AlsCorrection::process(Event& event) {
+    // Flush complete and additional info events are no samples. They must neither be corrected
+    // nor take the slot of a sample in the decimation.
+    if (event.sensorType == SensorType::META_DATA ||
+        event.sensorType == SensorType::ADDITIONAL_INFO ||
+        event.sensorType == SensorType::DYNAMIC_SENSOR_META) {
+        return true;
+    }
+    if (!isReady()) {
+        return true;
+    }
+
+    // Several sub-HAL callback threads may post for the same sensor, HalProxy does not serialize
+    // them. Instances do not share any state, so sensors never wait on each other here.
+    std::lock_guard<std::mutex> lock(mProcessMutex);
+
+    if (!correct(event)) {
+        return false;
+    }
+    if (mConfig.on_change_only && mState.emitted && event.u.scalar == mState.last_emitted_value) {
+        mDroppedUnchanged++;
+        return false;
+    }
+    mState.emitted = true;
+    mState.last_emitted_value = event.u.scalar;
+    return true;
+}
+
+void AlsCorrection::dump(std::ostream& stream) const {
+    if (!isReady()) {
+        stream << "  ALS correction of " << mName << ": "
+               << (mStarted ? "initializing" : "not started") << std::endl;
+        return;
     }
+    stream << "  ALS correction of " << mName << ": config " << mPropertyPrefix << ", init took "
+           << ns2ms(mConfigTime) << " ms" << std::endl;
+    stream << "    Capture age when used (ms): p50 <" << mCaptureAgeMs.getPercentile(0.5)
+           << ", p99 <" << mCaptureAgeMs.getPercentile(0.99) << std::endl;
+    stream << "    Decimation: min interval " << ns2ms(mConfig.min_interval) << " ms"
+           << (mConfig.on_change_only ? ", changes only" : "") << ", dropped " << mDroppedTooFast
+           << " too fast, " << mDroppedNoCapture << " without a capture, " << mDroppedUnchanged
+           << " unchanged, reused " << mReusedValues << " values" << std::endl;
 }
 
 }  // namespace implementation
@@ -6,9 +6,20 @@
 
 #pragma once
 
-#include <aidl/vendor/lineage/oplus_als/BnAreaCapture.h>
+#include "AlsCorrectionModel.h"
+#include "AlsScreen.h"
+#include "Histogram.h"
+
 #include <android/hardware/sensors/2.1/types.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace sensors {
@@ -17,10 +28,103 @@ namespace implementation {
 
 static constexpr int SENSOR_TYPE_QTI_WISE_LIGHT = 33171103;
 
+/**
+ * Correction of one light sensor under the screen, owned by its SensorEntry. Every instance has
+ * its own config, read from the properties under its prefix, and its own state, so several light
+ * sensors can be corrected independently.
+ */
 class AlsCorrection {
   public:
-    static void init();
-    static void process(Event& event);
+    static constexpr char kDefaultPropertyPrefix[] = "vendor.sensors.als_correction";
+
+    /**
+     * @param propertyPrefix Prefix of the config properties, the default one if empty.
+     */
+    AlsCorrection(const std::string& name, const std::string& propertyPrefix,
+                  std::shared_ptr<AlsScreen> screen);
+
+    /**
+     * Waits for init() if it runs. It no longer waits for the area capture service once the
+     * correction is being destroyed, but a wait that already started has to run out.
+     */
+    ~AlsCorrection();
+
+    /**
+     * Run init() on a background thread, once. Events pass through uncorrected until it is done,
+     * so sensor startup does not wait for the calibration files or the area capture service.
+     */
+    void start();
+    bool isReady() const;
+
+    /**
+     * Correct a light event in place. Callable from any sub-HAL callback thread. Meta events of
+     * the sensor pass through untouched.
+     *
+     * @return false if the event is decimated and must be dropped from the batch.
+     */
+    bool process(Event& event);
+
+    void dump(std::ostream& stream) const;
+
+  private:
+    struct Config {
+        bool hbr;
+        float rgbw_max_lux[4];
+        float rgbw_max_lux_div[4];
+        float rgbw_lux_postmul[4];
+        float rgbw_poly[4][4];
+        float grayscale_weights[3];
+        float sensor_gaincal_points[4];
+        float sensor_inverse_gain[4];
+        float agc_threshold;
+        float calib_gain;
+        float bias;
+        float max_brightness;
+        nsecs_t min_interval;
+        bool on_change_only;
+    };
+
+    struct HysteresisRange {
+        float middle;
+        float min, max;
+    };
+
+    struct State {
+        nsecs_t last_update = 0, last_forced_update = 0;
+        bool force_update = true;
+        float hyst_min = -1.0, hyst_max = -1.0;
+        float last_corrected_value = 0.0;
+        float last_agc_gain = 0.0;
+        uint64_t capture_generation = 0;
+        bool emitted = false;
+        float last_emitted_value = 0.0;
+    };
+
+    /**
+     * @return false if the correction started being destroyed before it was ready.
+     */
+    bool init();
+    bool correct(Event& event);
+    std::string getPropertyName(const char* key) const;
+
+    const std::string mName;
+    const std::string mPropertyPrefix;
+    const std::shared_ptr<AlsScreen> mScreen;
+
+    // Written by init() only, before mReady is set.
+    Config mConfig = {};
+    std::vector<HysteresisRange> mHysteresisRanges;
+    AlsCorrectionModel mModel;
+
+    std::mutex mProcessMutex;
+    State mState;
+
+    std::atomic_bool mStarted = false, mReady = false, mStopping = false;
+    std::thread mInitThread;
+    std::atomic<nsecs_t> mConfigTime = 0;
+    std::atomic<uint64_t> mDroppedTooFast = 0, mDroppedNoCapture = 0, mDroppedUnchanged = 0,
+                          mReusedValues = 0;
+    Log2Histogram mCaptureAgeMs;
 };
 
 }  // namespace implementation
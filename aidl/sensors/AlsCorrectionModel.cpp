@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AlsCorrectionModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void AlsCorrectionModel::init(const float poly[4][4], const float postmul[4],
+                              const float grayscaleWeights[3], float maxLuxWhite,
+                              float maxBrightness) {
+    for (size_t value = 0; value < kTableSize; value++) {
+        for (int i = 0; i < 4; i++) {
+            double lux = 0.0;
+            for (int j = 0; j < 4; j++) {
+                lux = lux * value + poly[i][j];
+            }
+            mChannelLux[i][value] = lux * postmul[i];
+        }
+        mGamma[value] = std::pow(value / 255.0, 2.2);
+    }
+    std::copy(grayscaleWeights, grayscaleWeights + 3, mGrayscaleWeights);
+    mMaxLuxWhite = maxLuxWhite;
+    mInverseMaxBrightness = maxBrightness > 0.0f ? 1.0f / maxBrightness : 0.0f;
+}
+
+float AlsCorrectionModel::getScreenLux(float r, float g, float b, float brightness) const {
+    float gray = r * mGrayscaleWeights[0] + g * mGrayscaleWeights[1] + b * mGrayscaleWeights[2];
+    float scale = brightness * mInverseMaxBrightness;
+
+    float lux = std::max(lookup(mChannelLux[0], r), 0.0f) +
+                std::max(lookup(mChannelLux[1], g), 0.0f) +
+                std::max(lookup(mChannelLux[2], b), 0.0f) - lookup(mChannelLux[3], gray);
+    float fullWhiteLux = mMaxLuxWhite * scale;
+    lux = std::min(lux * scale, fullWhiteLux);
+    return std::max(lux, lookup(mGamma, gray) * fullWhiteLux);
+}
+
+float AlsCorrectionModel::lookup(const float (&table)[kTableSize], float value) {
+    float clamped = std::clamp(value, 0.0f, static_cast<float>(kTableSize - 2));
+    size_t index = static_cast<size_t>(clamped);
+    float fraction = value - index;
+    return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
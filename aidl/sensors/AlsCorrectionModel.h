@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Estimates how much of the light the sensor sees comes from the screen above it, from the
+ * average color of that area and the backlight brightness.
+ *
+ * Per channel the screen adds postmul * poly(value) lux at full brightness, with poly a cubic over
+ * the 0-255 channel value; the white channel, computed from the grayscale value, is subtracted.
+ * The total scales with brightness and is kept between the full white output and a gamma 2.2
+ * estimate of the grayscale output. All of it except the final clamps is tabulated at init(), so
+ * an estimate only costs a few table loads and multiply-adds.
+ */
+class AlsCorrectionModel {
+  public:
+    void init(const float poly[4][4], const float postmul[4], const float grayscaleWeights[3],
+              float maxLuxWhite, float maxBrightness);
+
+    /**
+     * @param r, g, b Average color of the area above the sensor, 0-255.
+     * @return Estimated lux added by the screen.
+     */
+    float getScreenLux(float r, float g, float b, float brightness) const;
+
+  private:
+    // One entry per channel value.
+    static constexpr size_t kTableSize = 256;
+
+    // Interpolate between the two closest entries, extrapolate from the outer ones.
+    static float lookup(const float (&table)[kTableSize], float value);
+
+    float mChannelLux[4][kTableSize] = {};
+    float mGamma[kTableSize] = {};
+    float mGrayscaleWeights[3] = {};
+    float mMaxLuxWhite = 0.0f;
+    float mInverseMaxBrightness = 0.0f;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
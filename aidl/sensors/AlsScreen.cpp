@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AlsScreen.h"
+
+#include <android/binder_manager.h>
+#include <log/log.h>
+
+#include <fstream>
+#include <string>
+
+#define BRIGHTNESS_DIR "/sys/class/backlight/panel0-backlight/"
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void AlsScreen::connect() {
+    std::call_once(mConnectOnce, [this] {
+        mBrightness.start(BRIGHTNESS_DIR);
+        std::ifstream file(BRIGHTNESS_DIR "max_brightness");
+        if (!(file >> mMaxBrightness)) {
+            mMaxBrightness = 1023.0f;
+        }
+
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        const auto instancename = std::string(IAreaCapture::descriptor) + "/default";
+        if (AServiceManager_isDeclared(instancename.c_str())) {
+            mService = IAreaCapture::fromBinder(
+                    ::ndk::SpAIBinder(AServiceManager_waitForService(instancename.c_str())));
+        } else {
+            ALOGE("Service is not registered");
+        }
+        mServiceTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        mCaptureThread = std::thread([this] { captureLoop(); });
+        mConnected.store(true, std::memory_order_release);
+    });
+}
+
+AlsScreen::~AlsScreen() {
+    if (!mCaptureThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mCaptureMutex);
+        mStopping = true;
+    }
+    mCaptureCV.notify_one();
+    mCaptureThread.join();
+}
+
+void AlsScreen::requestCapture() {
+    {
+        std::lock_guard<std::mutex> lock(mCaptureMutex);
+        mCaptureRequested = true;
+    }
+    mCaptureCV.notify_one();
+}
+
+bool AlsScreen::getLatestCapture(AreaRgbCaptureResult* result, nsecs_t* time,
+                                 uint64_t* generation) {
+    std::lock_guard<std::mutex> lock(mCaptureMutex);
+    if (mCaptureGeneration == 0) {
+        return false;
+    }
+    *result = mCapture;
+    *time = mCaptureTime;
+    *generation = mCaptureGeneration;
+    return true;
+}
+
+uint64_t AlsScreen::getGeneration() {
+    std::lock_guard<std::mutex> lock(mCaptureMutex);
+    return mCaptureGeneration;
+}
+
+void AlsScreen::dump(std::ostream& stream) {
+    if (!mConnected.load(std::memory_order_acquire)) {
+        stream << "  ALS screen: connecting" << std::endl;
+        return;
+    }
+    stream << "  ALS screen: service took " << ns2ms(mServiceTime) << " ms, max brightness "
+           << mMaxBrightness << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(mCaptureMutex);
+        stream << "    Area captures: " << mCaptureGeneration << " taken, " << mNumFailedCaptures
+               << " failed" << (mCaptureRequested ? ", one pending" : "") << std::endl;
+    }
+    stream << "    Capture duration (ms): p50 <" << mCaptureDurationMs.getPercentile(0.5)
+           << ", p99 <" << mCaptureDurationMs.getPercentile(0.99) << std::endl;
+    mBrightness.dump(stream);
+}
+
+void AlsScreen::captureLoop() {
+    std::unique_lock<std::mutex> lock(mCaptureMutex);
+    while (true) {
+        mCaptureCV.wait(lock, [this] { return mCaptureRequested || mStopping; });
+        if (mStopping) {
+            return;
+        }
+        mCaptureRequested = false;
+        lock.unlock();
+
+        AreaRgbCaptureResult result;
+        nsecs_t start = systemTime(SYSTEM_TIME_BOOTTIME);
+        bool ok = mService != nullptr && mService->getAreaBrightness(&result).isOk();
+        nsecs_t end = systemTime(SYSTEM_TIME_BOOTTIME);
+        mCaptureDurationMs.record(ns2ms(end - start));
+
+        lock.lock();
+        if (ok) {
+            mCapture = result;
+            mCaptureTime = end;
+            mCaptureGeneration++;
+        } else {
+            ALOGE("Could not get area above sensor");
+            mNumFailedCaptures++;
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
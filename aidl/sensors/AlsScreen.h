@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "BrightnessTracker.h"
+#include "Histogram.h"
+
+#include <aidl/vendor/lineage/oplus_als/BnAreaCapture.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::aidl::vendor::lineage::oplus_als::AreaRgbCaptureResult;
+using ::aidl::vendor::lineage::oplus_als::IAreaCapture;
+
+/**
+ * What light sensors under the screen need to know about it: the color of the area above them,
+ * captured on a worker thread so that events never wait on SurfaceFlinger, and the backlight
+ * brightness. There is one screen, so all AlsCorrection instances share one of these.
+ */
+class AlsScreen {
+  public:
+    /**
+     * Stops the capture worker and waits for it. Must not race with connect().
+     */
+    ~AlsScreen();
+
+    /**
+     * Connect to the area capture service and start following the backlight. The first call does
+     * the work and the others wait for it, so only call it from background threads.
+     */
+    void connect();
+
+    float getBrightness(int64_t timestampNs) const {
+        return mBrightness.getBrightness(timestampNs);
+    }
+
+    /**
+     * Only valid once connect() returned.
+     */
+    float getMaxBrightness() const { return mMaxBrightness; }
+
+    /**
+     * Have the worker take a new capture, without waiting for it. Requests that come in while a
+     * capture runs are merged into the next one.
+     */
+    void requestCapture();
+
+    /**
+     * @param generation Set to the generation of the capture, which grows with every capture.
+     * @return false if no capture succeeded yet.
+     */
+    bool getLatestCapture(AreaRgbCaptureResult* result, nsecs_t* time, uint64_t* generation);
+
+    uint64_t getGeneration();
+
+    void dump(std::ostream& stream);
+
+  private:
+    void captureLoop();
+
+    std::once_flag mConnectOnce;
+    std::atomic_bool mConnected = false;
+    std::shared_ptr<IAreaCapture> mService;
+    nsecs_t mServiceTime = 0;
+    BrightnessTracker mBrightness;
+    float mMaxBrightness = 0.0f;
+
+    std::thread mCaptureThread;
+    std::mutex mCaptureMutex;
+    std::condition_variable mCaptureCV;
+    bool mCaptureRequested = false;
+    bool mStopping = false;
+    AreaRgbCaptureResult mCapture = {0.0, 0.0, 0.0};
+    nsecs_t mCaptureTime = 0;
+    uint64_t mCaptureGeneration = 0;
+    uint64_t mNumFailedCaptures = 0;
+    Log2Histogram mCaptureDurationMs;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
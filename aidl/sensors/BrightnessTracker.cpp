@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "BrightnessTracker.h"
+
+#include <fcntl.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utils/Timers.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+static bool readValue(int fd, float* value) {
+    char buf[16];
+    ssize_t size = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (size <= 0) {
+        return false;
+    }
+    buf[size] = '\0';
+
+    char* end;
+    long parsed = strtol(buf, &end, 10);
+    if (end == buf) {
+        return false;
+    }
+    *value = static_cast<float>(parsed);
+    return true;
+}
+
+bool BrightnessTracker::start(const std::string& dir) {
+    std::string path = dir + "brightness";
+    mFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) {
+        ALOGE("Failed to open %s: %d", path.c_str(), errno);
+        return false;
+    }
+    // The backlight core only notifies changes on actual_brightness. Without it, poll() below
+    // just sleeps and every change is picked up by the fallback reads.
+    mNotifyFd = open((dir + "actual_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+
+    update(false);
+    mStopFd = eventfd(0, EFD_CLOEXEC);
+    if (mStopFd < 0) {
+        // Keep the first reading rather than start a thread that could never be stopped.
+        ALOGE("Failed to create eventfd: %d", errno);
+        return true;
+    }
+    mThread = std::thread([this] { run(); });
+    return true;
+}
+
+BrightnessTracker::~BrightnessTracker() {
+    if (mThread.joinable()) {
+        uint64_t value = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd, &value, sizeof(value)));
+        mThread.join();
+    }
+    for (int fd : {mFd, mNotifyFd, mStopFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+float BrightnessTracker::getBrightness(int64_t timestampNs) const {
+    while (true) {
+        uint64_t numSamples = mNumSamples.load(std::memory_order_acquire);
+        if (numSamples == 0) {
+            return 0.0f;
+        }
+
+        // The slot after the newest one may be getting rewritten, leave it out.
+        uint64_t oldest = numSamples > kHistorySize - 1 ? numSamples - (kHistorySize - 1) : 0;
+        float value = 0.0f;
+        for (uint64_t i = numSamples; i-- > oldest;) {
+            const Sample& sample = mHistory[i % kHistorySize];
+            value = sample.value.load(std::memory_order_relaxed);
+            if (sample.timeNs.load(std::memory_order_relaxed) <= timestampNs) {
+                break;
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mNumSamples.load(std::memory_order_relaxed) == numSamples) {
+            return value;
+        }
+    }
+}
+
+void BrightnessTracker::dump(std::ostream& stream) const {
+    uint64_t numSamples = mNumSamples.load(std::memory_order_acquire);
+    stream << "    Brightness: " << getBrightness(INT64_MAX) << ", " << numSamples
+           << " changes, " << mNumNotifications << " notifications, " << mNumFallbackChanges
+           << " changes only caught by polling" << std::endl;
+}
+
+void BrightnessTracker::run() {
+    // poll() skips the notification node if there is none.
+    struct pollfd pfds[] = {
+            {.fd = mNotifyFd, .events = POLLPRI | POLLERR, .revents = 0},
+            {.fd = mStopFd, .events = POLLIN, .revents = 0},
+    };
+    while (true) {
+        if (mNotifyFd >= 0) {
+            // sysfs only notifies again once the attribute was read.
+            char buf[16];
+            pread(mNotifyFd, buf, sizeof(buf), 0);
+        }
+
+        int ret = poll(pfds, 2, kFallbackPollMs);
+        if (ret < 0 && errno != EINTR) {
+            ALOGE("Failed to poll brightness, stopping: %d", errno);
+            return;
+        }
+        if (ret > 0 && pfds[1].revents != 0) {
+            return;
+        }
+        update(ret > 0 && pfds[0].revents != 0);
+    }
+}
+
+void BrightnessTracker::update(bool notified) {
+    float value;
+    if (!readValue(mFd, &value)) {
+        return;
+    }
+    if (notified) {
+        mNumNotifications++;
+    }
+
+    // Only this thread publishes, after start() is done.
+    uint64_t numSamples = mNumSamples.load(std::memory_order_relaxed);
+    if (numSamples > 0 &&
+        mHistory[(numSamples - 1) % kHistorySize].value.load(std::memory_order_relaxed) == value) {
+        return;
+    }
+    if (numSamples > 0 && !notified) {
+        mNumFallbackChanges++;
+    }
+
+    Sample& sample = mHistory[numSamples % kHistorySize];
+    sample.timeNs.store(systemTime(SYSTEM_TIME_BOOTTIME), std::memory_order_relaxed);
+    sample.value.store(value, std::memory_order_relaxed);
+    mNumSamples.store(numSamples + 1, std::memory_order_release);
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
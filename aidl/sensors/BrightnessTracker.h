@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Follows the brightness of a backlight device without reopening its sysfs node for every
+ * reading. The node stays open and is read with pread() whenever the backlight core signals a
+ * change on actual_brightness, or every kFallbackPollMs for drivers that never do.
+ *
+ * The last few values are published lock free together with the CLOCK_BOOTTIME time they were
+ * read, so that a sensor sample can be matched with the brightness at its timestamp.
+ */
+class BrightnessTracker {
+  public:
+    /**
+     * Stops the thread and waits for it.
+     */
+    ~BrightnessTracker();
+
+    /**
+     * Start following the backlight device in dir, on a thread of its own.
+     *
+     * @return false if the brightness node cannot be opened.
+     */
+    bool start(const std::string& dir);
+
+    /**
+     * @return The brightness in effect at timestampNs, the oldest known one if it is older than
+     *         the history, or 0 if nothing was read yet.
+     */
+    float getBrightness(int64_t timestampNs) const;
+
+    void dump(std::ostream& stream) const;
+
+  private:
+    static constexpr size_t kHistorySize = 8;
+    static constexpr int kFallbackPollMs = 500;
+
+    struct Sample {
+        std::atomic<int64_t> timeNs = 0;
+        std::atomic<float> value = 0.0f;
+    };
+
+    void run();
+    void update(bool notified);
+
+    int mFd = -1;
+    int mNotifyFd = -1;
+    // Written once to make the thread return.
+    int mStopFd = -1;
+    std::thread mThread;
+
+    // Sample i lives in mHistory[i % kHistorySize], mNumSamples is bumped once it is complete.
+    Sample mHistory[kHistorySize];
+    std::atomic<uint64_t> mNumSamples = 0;
+
+    std::atomic<uint64_t> mNumNotifications = 0;
+    std::atomic<uint64_t> mNumFallbackChanges = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
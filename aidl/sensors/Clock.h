@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+constexpr int64_t kNsPerUs = 1000;
+constexpr int64_t kNsPerMs = 1000 * kNsPerUs;
+constexpr int64_t kNsPerSec = 1000 * kNsPerMs;
+
+inline int64_t getClockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * kNsPerSec + ts.tv_nsec;
+}
+
+/**
+ * Clock of durations and of the stamps of events queued to the pending writes lanes.
+ */
+inline int64_t getMonotonicTimeNs() {
+    return getClockNs(CLOCK_MONOTONIC);
+}
+
+/**
+ * Clock of event timestamps and of the wakelock timeout.
+ */
+inline int64_t getBoottimeNs() {
+    return getClockNs(CLOCK_BOOTTIME);
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
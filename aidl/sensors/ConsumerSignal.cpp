@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ConsumerSignal.h"
+
+#include "Clock.h"
+
+#include <log/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+ConsumerSignal::ConsumerSignal() {
+    mEventFd = eventfd(0, EFD_CLOEXEC);
+    if (mEventFd < 0) {
+        ALOGE("Failed to create eventfd: %d", errno);
+    }
+}
+
+ConsumerSignal::~ConsumerSignal() {
+    if (mEventFd >= 0) {
+        close(mEventFd);
+    }
+}
+
+void ConsumerSignal::notify() {
+    if (mIdle.exchange(false)) {
+        forceNotify();
+    }
+}
+
+void ConsumerSignal::forceNotify() {
+    uint64_t value = 1;
+    TEMP_FAILURE_RETRY(write(mEventFd, &value, sizeof(value)));
+}
+
+void ConsumerSignal::block(int64_t timeoutNs) {
+    if (timeoutNs >= 0) {
+        struct pollfd pfd = {.fd = mEventFd, .events = POLLIN};
+        int timeoutMs = static_cast<int>((timeoutNs + kNsPerMs - 1) / kNsPerMs);
+        if (TEMP_FAILURE_RETRY(poll(&pfd, 1, timeoutMs)) <= 0) {
+            return;
+        }
+    }
+    uint64_t value;
+    TEMP_FAILURE_RETRY(read(mEventFd, &value, sizeof(value)));
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
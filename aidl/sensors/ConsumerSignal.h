@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Wakes a single consumer thread that sleeps on an eventfd. Producers only pay for the write()
+ * when the consumer has announced that it is about to sleep.
+ */
+class ConsumerSignal {
+  public:
+    ConsumerSignal();
+    ~ConsumerSignal();
+
+    /**
+     * Producer side: wake the consumer if it is idle.
+     */
+    void notify();
+
+    /**
+     * Producer side: wake the consumer unconditionally, e.g. to make it notice shutdown.
+     */
+    void forceNotify();
+
+    /**
+     * Consumer side: sleep until notified, unless hasWork() turns true after going idle.
+     *
+     * @param timeoutNs Give up after this long, never if negative.
+     */
+    template <typename Predicate>
+    void wait(Predicate hasWork, int64_t timeoutNs = -1) {
+        mIdle.store(true);
+        if (hasWork()) {
+            mIdle.store(false);
+            return;
+        }
+        block(timeoutNs);
+        mIdle.store(false);
+    }
+
+  private:
+    void block(int64_t timeoutNs);
+
+    int mEventFd;
+    std::atomic_bool mIdle = false;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DirectChannelRouter.h"
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SharedMemType;
+
+static constexpr SensorFlagBits kMemTypeFlags[] = {
+        SensorFlagBits::DIRECT_CHANNEL_ASHMEM,
+        SensorFlagBits::DIRECT_CHANNEL_GRALLOC,
+};
+
+size_t DirectChannelRouter::getMemTypeIndex(SharedMemType type) {
+    return type == SharedMemType::ASHMEM ? 0 : 1;
+}
+
+void DirectChannelRouter::addSensor(size_t subHalIndex, SensorInfo* sensor) {
+    for (size_t i = 0; i < kNumMemTypes; i++) {
+        uint32_t flag = static_cast<uint32_t>(kMemTypeFlags[i]);
+        if ((sensor->flags & flag) == 0) {
+            continue;
+        }
+        if (!mOwners[i].has_value()) {
+            mOwners[i] = subHalIndex;
+        } else if (*mOwners[i] != subHalIndex) {
+            sensor->flags &= ~flag;
+        }
+    }
+    // A sensor left without any channel type cannot report directly at any rate.
+    if ((sensor->flags & SensorFlagBits::MASK_DIRECT_CHANNEL) == 0) {
+        sensor->flags &= ~static_cast<uint32_t>(SensorFlagBits::MASK_DIRECT_REPORT);
+    }
+}
+
+std::optional<size_t> DirectChannelRouter::getSubHalIndex(SharedMemType type) const {
+    return mOwners[getMemTypeIndex(type)];
+}
+
+int32_t DirectChannelRouter::addChannel(const Channel& channel) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    int32_t channelHandle = mNextChannelHandle++;
+    mChannels[channelHandle] = channel;
+    return channelHandle;
+}
+
+bool DirectChannelRouter::findChannel(int32_t channelHandle, Channel* channel) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mChannels.find(channelHandle);
+    if (it == mChannels.end()) {
+        return false;
+    }
+    *channel = it->second;
+    return true;
+}
+
+bool DirectChannelRouter::removeChannel(int32_t channelHandle, Channel* channel) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mChannels.find(channelHandle);
+    if (it == mChannels.end()) {
+        return false;
+    }
+    *channel = it->second;
+    mChannels.erase(it);
+    return true;
+}
+
+void DirectChannelRouter::dump(std::ostream& stream) {
+    static const char* const kMemTypeNames[] = {"ashmem", "gralloc"};
+    stream << "  Direct channels:";
+    for (size_t i = 0; i < kNumMemTypes; i++) {
+        stream << " " << kMemTypeNames[i] << " served by ";
+        if (mOwners[i].has_value()) {
+            stream << "subhal " << *mOwners[i];
+        } else {
+            stream << "none";
+        }
+        stream << (i + 1 < kNumMemTypes ? "," : "");
+    }
+    stream << std::endl;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& [channelHandle, channel] : mChannels) {
+        stream << "    Channel " << channelHandle << ": subhal " << channel.subHalIndex
+               << " channel " << channel.subHalChannelHandle << std::endl;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
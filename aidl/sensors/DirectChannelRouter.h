@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Routes direct channels to the sub-HALs that serve them.
+ *
+ * The framework may configure any direct capable sensor on any channel of a matching memory type,
+ * but a channel is a single ring in shared memory that only one writer can fill. So every memory
+ * type is served by one sub-HAL, the first one with a sensor that supports it, and the other
+ * sub-HALs lose direct channel support for that type. Different types may be served by different
+ * sub-HALs, e.g. ashmem by the one with the IMU and gralloc by another.
+ *
+ * Channel handles are handed out by HalProxy and translated to the handle the serving sub-HAL
+ * gave out, so that the handle namespaces of the sub-HALs never collide. The router only keeps
+ * the bookkeeping, HalProxy makes the sub-HAL calls between looking a channel up and adding or
+ * removing it, without any lock held.
+ */
+class DirectChannelRouter {
+  public:
+    struct Channel {
+        size_t subHalIndex = 0;
+        int32_t subHalChannelHandle = -1;
+    };
+
+    /**
+     * Called for every static sensor, in sub-HAL order. Claims the memory types the sensor
+     * supports for its sub-HAL if no other sub-HAL did, and strips the ones claimed by another
+     * sub-HAL from its flags.
+     */
+    void addSensor(size_t subHalIndex, SensorInfo* sensor);
+
+    /**
+     * @return The sub-HAL serving channels of a memory type, if any.
+     */
+    std::optional<size_t> getSubHalIndex(V1_0::SharedMemType type) const;
+
+    /**
+     * Add a channel the sub-HAL registered.
+     *
+     * @return The handle HalProxy gives out for it.
+     */
+    int32_t addChannel(const Channel& channel);
+
+    bool findChannel(int32_t channelHandle, Channel* channel);
+
+    /**
+     * Remove a channel, so that no new reports can be configured on it.
+     *
+     * @return false if there is no such channel.
+     */
+    bool removeChannel(int32_t channelHandle, Channel* channel);
+
+    void dump(std::ostream& stream);
+
+  private:
+    static constexpr size_t kNumMemTypes = 2;
+
+    // Index of a memory type in mOwners, ashmem then gralloc.
+    static size_t getMemTypeIndex(V1_0::SharedMemType type);
+
+    // Sub-HAL serving each memory type. Only written while the sensor list is built.
+    std::optional<size_t> mOwners[kNumMemTypes];
+
+    std::mutex mMutex;
+    std::map<int32_t, Channel> mChannels;
+    int32_t mNextChannelHandle = 1;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EventQueueWriter.h"
+
+#include "HalProxyState.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void EventQueueWriter::setEventQueue(std::unique_ptr<IEventQueue> eventQueue,
+                                     V2_0::implementation::IScopedWakelockRefCounter* refCounter) {
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    mEventQueue = std::move(eventQueue);
+    mRefCounter = refCounter;
+}
+
+void EventQueueWriter::wakeReader(bool urgent) {
+    HalProxyState& state = getHalProxyState();
+    if (state.readerWake.shouldWakeNow(urgent)) {
+        mEventQueue->wakeReader();
+        state.readerWake.onWake();
+    } else {
+        // The pending writes thread delivers the deferred wake.
+        state.pendingWritesSignal.notify();
+    }
+}
+
+void EventQueueWriter::postEvents(const std::vector<Event>& events, size_t numWakeupEvents) {
+    HalProxyState& state = getHalProxyState();
+    size_t numToWrite = 0;
+    {
+        // Never wait for the pending writes thread, it may be blocked on a full FMQ. Whatever
+        // cannot be written right away goes to the backlog instead.
+        std::unique_lock<std::mutex> lock(mWriteMutex, std::try_to_lock);
+        if (lock.owns_lock() && !state.hasPendingWrites()) {
+            numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
+            if (numToWrite > 0) {
+                if (mEventQueue->write(events.data(), numToWrite)) {
+                    bool urgent = numWakeupEvents > 0 || mEventQueue->availableToWrite() == 0 ||
+                                  (state.readerWake.isEnabled() &&
+                                   state.hasUrgentEvents(events.data(), numToWrite));
+                    wakeReader(urgent);
+                    state.onEventsWritten(nullptr, events.data(), numToWrite);
+                } else {
+                    numToWrite = 0;
+                }
+            }
+        }
+    }
+    if (numToWrite == events.size()) {
+        return;
+    }
+
+    // The framework will never acknowledge events that are not queued, so give their wakelock
+    // share back now.
+    size_t wakeupEnd = std::max(numToWrite, std::min(numWakeupEvents, events.size()));
+    size_t numWakeupNotQueued = state.queuePendingWrites(
+            kWakeupLane, events.data() + numToWrite, wakeupEnd - numToWrite);
+    if (numWakeupNotQueued > 0) {
+        mRefCounter->decrementRefCountAndMaybeReleaseWakelock(numWakeupNotQueued);
+    }
+    // A batch always comes from a single sub-HAL.
+    size_t subHalLane = state.getSubHalLaneIndex(static_cast<uint32_t>(events[0].sensorHandle) >>
+                                                 SensorRegistry::kBitsAfterSubHalIndex);
+    state.queuePendingWrites(subHalLane, events.data() + wakeupEnd, events.size() - wakeupEnd);
+}
+
+void EventQueueWriter::handlePendingWrites(const std::atomic_bool& threadsRun) {
+    HalProxyState& state = getHalProxyState();
+    std::vector<Event> spilledEvents(mEventQueue->getQuantumCount());
+    bool wroteEvents = false;
+    bool urgent = false;
+
+    // Write up to quota events of a lane. A lane that wraps around the end of its ring is written
+    // in two runs, its spilled events only once the ring is empty so that they stay in order.
+    auto writeLane = [&](size_t laneIndex, size_t quota) {
+        PendingWriteLane& lane = state.pendingWrites[laneIndex];
+        size_t numEvicted = state.evictOldest(lane);
+        if (numEvicted > 0 && laneIndex == kWakeupLane) {
+            mRefCounter->decrementRefCountAndMaybeReleaseWakelock(numEvicted);
+        }
+        for (int run = 0; run < 2 && quota > 0; run++) {
+            Event* events;
+            size_t numToWrite =
+                    lane.events.peek(std::min(quota, mEventQueue->availableToWrite()), &events);
+            if (numToWrite == 0 || !mEventQueue->write(events, numToWrite)) {
+                break;
+            }
+            urgent |= laneIndex == kWakeupLane ||
+                      (state.readerWake.isEnabled() && state.hasUrgentEvents(events, numToWrite));
+            state.onEventsWritten(&lane, events, numToWrite);
+            lane.events.consume(numToWrite);
+            quota -= numToWrite;
+            state.numEventsWrittenFromBacklog += numToWrite;
+            wroteEvents = true;
+        }
+        if (!lane.events.empty()) {
+            return;
+        }
+        size_t numSpilled = state.takeSpill(
+                lane, spilledEvents.data(),
+                std::min({quota, spilledEvents.size(), mEventQueue->availableToWrite()}));
+        if (numSpilled == 0) {
+            return;
+        }
+        if (mEventQueue->write(spilledEvents.data(), numSpilled)) {
+            urgent |= laneIndex == kWakeupLane ||
+                      (state.readerWake.isEnabled() &&
+                       state.hasUrgentEvents(spilledEvents.data(), numSpilled));
+            state.onEventsWritten(nullptr, spilledEvents.data(), numSpilled);
+            state.numEventsWrittenFromBacklog += numSpilled;
+            wroteEvents = true;
+        } else {
+            ALOGE("Dropping %zu spilled %s events after write failed.", numSpilled,
+                  lane.name.c_str());
+            if (laneIndex == kWakeupLane) {
+                mRefCounter->decrementRefCountAndMaybeReleaseWakelock(numSpilled);
+            }
+            lane.numDropped += numSpilled;
+        }
+    };
+
+    while (threadsRun.load()) {
+        int64_t wakeDelayNs = state.readerWake.getDeferredWakeDelayNs();
+        if (wakeDelayNs != 0) {
+            state.pendingWritesSignal.wait(
+                    [&] {
+                        return state.hasPendingWrites() || !threadsRun.load() ||
+                               (wakeDelayNs < 0 && state.readerWake.hasDeferredWake());
+                    },
+                    wakeDelayNs);
+        }
+        if (!threadsRun.load()) {
+            break;
+        }
+
+        // Write as much of the backlog as fits, wake up lane first.
+        {
+            std::lock_guard<std::mutex> lock(mWriteMutex);
+            wroteEvents = false;
+            urgent = false;
+            PendingWriteLane& wakeupLane = state.pendingWrites[kWakeupLane];
+            writeLane(kWakeupLane, SIZE_MAX);
+
+            // Share what is left of the FMQ between the sub-HALs with events pending, starting one
+            // further every pass so that none of them is always served last.
+            size_t numSubHalLanes = state.getNumSubHalLanes();
+            size_t numBusyLanes = 0;
+            for (size_t i = 0; i < numSubHalLanes; i++) {
+                const PendingWriteLane& lane = state.pendingWrites[kFirstSubHalLane + i];
+                if (!lane.events.empty() || lane.spillSize > 0) {
+                    numBusyLanes++;
+                }
+            }
+            if (wakeupLane.events.empty() && wakeupLane.spillSize == 0 && numBusyLanes > 0) {
+                size_t quota =
+                        std::max<size_t>(1, mEventQueue->availableToWrite() / numBusyLanes);
+                for (size_t i = 0; i < numSubHalLanes; i++) {
+                    writeLane(kFirstSubHalLane + (state.nextSubHalLane + i) % numSubHalLanes,
+                              quota);
+                }
+                state.nextSubHalLane = (state.nextSubHalLane + 1) % numSubHalLanes;
+            }
+            for (size_t i = 0; i < numSubHalLanes; i++) {
+                state.watchdog.checkFlooding(
+                        i, state.pendingWrites[kFirstSubHalLane + i].isAboveHighWater());
+            }
+
+            if (wroteEvents) {
+                // A full FMQ only drains once the reader is awake.
+                wakeReader(urgent || mEventQueue->availableToWrite() == 0);
+            } else if (state.readerWake.getDeferredWakeDelayNs() == 0) {
+                wakeReader(true /* urgent */);
+            }
+        }
+
+        if (!state.hasPendingWrites() || !threadsRun.load()) {
+            continue;
+        }
+        if (mEventQueue->availableToWrite() > 0) {
+            // There is room left, so a producer is still filling in the slots it reserved. It
+            // signals once it commits them. Keep any deferred reader wake on time meanwhile.
+            state.pendingWritesSignal.wait(
+                    [&] { return state.hasCommittedPendingWrites() || !threadsRun.load(); },
+                    state.readerWake.getDeferredWakeDelayNs());
+            continue;
+        }
+
+        // The FMQ is full, wait for the framework to read from it.
+        if (!mEventQueue->waitForRead(kPendingWriteTimeoutNs) && threadsRun.load()) {
+            // Give up on the least important events first: those of the sub-HAL with the longest
+            // backlog, and only then wake up events.
+            size_t laneIndex = kWakeupLane;
+            size_t mostPending = 0;
+            for (size_t i = kFirstSubHalLane; i < state.pendingWrites.size(); i++) {
+                const PendingWriteLane& lane = state.pendingWrites[i];
+                size_t numPending = lane.events.size() + lane.spillSize;
+                if (numPending > mostPending) {
+                    laneIndex = i;
+                    mostPending = numPending;
+                }
+            }
+            PendingWriteLane& lane = state.pendingWrites[laneIndex];
+            Event* events;
+            size_t numToDrop = lane.events.peek(mEventQueue->getQuantumCount(), &events);
+            if (numToDrop > 0) {
+                lane.events.consume(numToDrop);
+            } else {
+                numToDrop = state.takeSpill(lane, spilledEvents.data(), spilledEvents.size());
+            }
+            if (numToDrop > 0) {
+                ALOGE("Dropping %zu %s events after blockingWrite failed.", numToDrop,
+                      lane.name.c_str());
+                if (laneIndex == kWakeupLane) {
+                    mRefCounter->decrementRefCountAndMaybeReleaseWakelock(numToDrop);
+                }
+                lane.numDropped += numToDrop;
+            }
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
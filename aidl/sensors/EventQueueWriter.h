@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "Clock.h"
+#include "V2_0/ScopedWakelock.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * The event FMQ as far as EventQueueWriter needs it. HalProxy implements it on top of the FMQ and
+ * its event flag, the pipeline benchmark on top of a fake.
+ */
+class IEventQueue {
+  public:
+    virtual ~IEventQueue() = default;
+
+    virtual size_t availableToWrite() = 0;
+    virtual size_t getQuantumCount() = 0;
+    virtual bool write(const Event* events, size_t count) = 0;
+
+    /**
+     * Tell the reader there are events to read and process.
+     */
+    virtual void wakeReader() = 0;
+
+    /**
+     * Wait for the reader to read events.
+     *
+     * @return false if it did not within timeoutNs.
+     */
+    virtual bool waitForRead(int64_t timeoutNs) = 0;
+};
+
+/**
+ * Writes posted events to the event FMQ: directly when the FMQ has room and nothing is pending,
+ * otherwise through the pending write lanes of HalProxyState, which the pending writes thread
+ * drains. Every write to the FMQ is serialized by the writer.
+ */
+class EventQueueWriter {
+  public:
+    // How long the pending writes thread waits on a full FMQ before it drops events.
+    static constexpr int64_t kPendingWriteTimeoutNs = 5 * kNsPerSec;
+
+    /**
+     * Must not be called while events are posted or the pending writes thread runs.
+     *
+     * @param refCounter Given back the wakelock share of wake up events that are dropped.
+     */
+    void setEventQueue(std::unique_ptr<IEventQueue> eventQueue,
+                       V2_0::implementation::IScopedWakelockRefCounter* refCounter);
+
+    /**
+     * Write a batch of events of a single sub-HAL, wake up events first, without ever blocking on
+     * the pending writes thread. Whatever cannot be written right away is queued.
+     */
+    void postEvents(const std::vector<Event>& events, size_t numWakeupEvents);
+
+    /**
+     * The pending writes thread, runs until threadsRun is cleared and pendingWritesSignal and the
+     * reader wait of the event queue are forced awake.
+     */
+    void handlePendingWrites(const std::atomic_bool& threadsRun);
+
+  private:
+    /**
+     * Wake the reader after events were written, unless the wake can be coalesced with a later
+     * one. Must be called with mWriteMutex held.
+     */
+    void wakeReader(bool urgent);
+
+    std::mutex mWriteMutex;
+    std::unique_ptr<IEventQueue> mEventQueue;
+    V2_0::implementation::IScopedWakelockRefCounter* mRefCounter = nullptr;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
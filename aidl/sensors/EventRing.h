@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Fixed capacity multi-producer/single-consumer ring.
+ *
+ * Producers reserve a run of slots with a single CAS on the tail, fill them in place and publish
+ * each slot through its sequence number, so they never wait on each other or on the consumer.
+ * The consumer reads the published prefix in place and releases it by moving the head forward.
+ * Producers may stamp the slots they publish, e.g. with the time they were queued.
+ */
+template <typename T>
+class EventRing {
+  public:
+    /**
+     * A run of slots handed out by reserve(). Slots are addressed through slot(), which takes care
+     * of the run wrapping around the end of the storage.
+     */
+    struct Reservation {
+        uint64_t start = 0;
+        size_t count = 0;
+
+        explicit operator bool() const { return count > 0; }
+    };
+
+    /**
+     * @param capacityPow2 Number of slots, rounded up to a power of two.
+     */
+    explicit EventRing(size_t capacityPow2) {
+        mCapacity = 1;
+        while (mCapacity < capacityPow2) mCapacity <<= 1;
+        mMask = mCapacity - 1;
+        mItems = std::make_unique<T[]>(mCapacity);
+        mSequences = std::make_unique<std::atomic<uint64_t>[]>(mCapacity);
+        mStamps = std::make_unique<int64_t[]>(mCapacity);
+        for (size_t i = 0; i < mCapacity; i++) {
+            mSequences[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    /**
+     * Reserve count slots for the caller to fill in place. Safe to call from any number of
+     * threads. Every successful reservation must be passed to commit().
+     *
+     * @return An empty reservation if there is not enough free space.
+     */
+    Reservation reserve(size_t count) {
+        if (count == 0 || count > mCapacity) return {};
+
+        uint64_t pos = mTail.load(std::memory_order_relaxed);
+        do {
+            if (pos + count - mHead.load(std::memory_order_acquire) > mCapacity) {
+                return {};
+            }
+        } while (!mTail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed,
+                                              std::memory_order_relaxed));
+        return {pos, count};
+    }
+
+    T& slot(const Reservation& reservation, size_t i) {
+        return mItems[(reservation.start + i) & mMask];
+    }
+
+    /**
+     * Publish the first used slots of a reservation. The consumer silently skips the rest.
+     */
+    void commit(const Reservation& reservation, size_t used, int64_t stamp = 0) {
+        for (size_t i = 0; i < reservation.count; i++) {
+            uint64_t index = reservation.start + i;
+            mStamps[index & mMask] = stamp;
+            uint64_t sequence = (index + 1) | (i < used ? 0 : kSkipBit);
+            mSequences[index & mMask].store(sequence, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Append count items. Safe to call from any number of threads.
+     *
+     * @return false, without writing anything, if there is not enough free space.
+     */
+    bool push(const T* items, size_t count, int64_t stamp = 0) {
+        if (count == 0) return true;
+        Reservation reservation = reserve(count);
+        if (!reservation) return false;
+
+        for (size_t i = 0; i < count; i++) {
+            slot(reservation, i) = items[i];
+        }
+        commit(reservation, count, stamp);
+        return true;
+    }
+
+    /**
+     * Return the longest published run starting at the head that is contiguous in memory. A
+     * wrapped backlog is therefore read in two calls. Consumer thread only.
+     *
+     * @param maxCount Upper bound for the returned run.
+     * @param first Set to the first item of the run.
+     *
+     * @return The number of items in the run.
+     */
+    size_t peek(size_t maxCount, T** first) {
+        uint64_t head = mHead.load(std::memory_order_relaxed);
+        while (mSequences[head & mMask].load(std::memory_order_acquire) ==
+               ((head + 1) | kSkipBit)) {
+            head++;
+            mHead.store(head, std::memory_order_release);
+        }
+        size_t offset = head & mMask;
+        size_t limit = std::min(maxCount, mCapacity - offset);
+        size_t count = 0;
+        while (count < limit &&
+               mSequences[offset + count].load(std::memory_order_acquire) == head + count + 1) {
+            count++;
+        }
+        *first = &mItems[offset];
+        return count;
+    }
+
+    /**
+     * @return Whether the slot at the head has been committed, used or not, so that peek() can
+     *         make progress. false while the ring is empty or a producer is still filling in the
+     *         oldest reservation. Consumer thread only.
+     */
+    bool isHeadCommitted() const {
+        uint64_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        uint64_t sequence = mSequences[head & mMask].load(std::memory_order_acquire);
+        return (sequence & ~kSkipBit) == head + 1;
+    }
+
+    /**
+     * @return The stamp an item returned by peek() was committed with. Consumer thread only.
+     */
+    int64_t getStamp(const T* item) const { return mStamps[item - mItems.get()]; }
+
+    /**
+     * Release count items previously returned by peek(). Consumer thread only.
+     */
+    void consume(size_t count) { mHead.fetch_add(count, std::memory_order_release); }
+
+    /**
+     * Drop everything that has been reserved so far. Only safe while no producer is active.
+     */
+    void clear() { mHead.store(mTail.load(std::memory_order_acquire), std::memory_order_release); }
+
+    /**
+     * Number of reserved slots, including ones a producer is still filling in.
+     */
+    size_t size() const {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mCapacity; }
+
+  private:
+    // Marks a slot that was reserved but left unused by its producer.
+    static constexpr uint64_t kSkipBit = UINT64_C(1) << 63;
+
+    size_t mCapacity;
+    size_t mMask;
+    std::unique_ptr<T[]> mItems;
+    std::unique_ptr<std::atomic<uint64_t>[]> mSequences;
+    std::unique_ptr<int64_t[]> mStamps;
+
+    alignas(64) std::atomic<uint64_t> mHead = 0;
+    alignas(64) std::atomic<uint64_t> mTail = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
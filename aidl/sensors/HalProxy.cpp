@@ -17,11 +17,13 @@
 #include "AlsCorrection.h"
 
 #include "HalProxy.h"
+#include "HalProxyState.h"
 
 #include <android/hardware/sensors/2.0/types.h>
 
 #include <android-base/file.h>
-#include "hardware_legacy/power.h"
+#include <android-base/properties.h>
+#include <utils/Timers.h>
 
 #include <dlfcn.h>
 
@@ -37,10 +39,12 @@ namespace sensors {
 namespace V2_1 {
 namespace implementation {
 
+using ::android::base::GetBoolProperty;
+using ::android::base::GetIntProperty;
+using ::android::base::GetProperty;
 using ::android::hardware::sensors::V1_0::Result;
 using ::android::hardware::sensors::V2_0::EventQueueFlagBits;
 using ::android::hardware::sensors::V2_0::WakeLockQueueFlagBits;
-using ::android::hardware::sensors::V2_0::implementation::getTimeNow;
 using ::android::hardware::sensors::V2_0::implementation::kWakelockTimeoutNs;
 
 typedef V2_0::implementation::ISensorsSubHal*(SensorsHalGetSubHalFunc)(uint32_t*);
@@ -83,47 +87,191 @@ int64_t msFromNs(int64_t nanos) {
     return nanos / nanosecondsInAMillsecond;
 }
 
-bool patchOplusGlanceSensor(V2_1::SensorInfo& sensor) {
-    if (sensor.typeAsString != "qti.sensor.amd") {
-        return true;
+/**
+ * Precompute what the event path has to do for a sensor from the static sensor list.
+ */
+void addSensorEntry(const V2_1::SensorInfo& sensor, const SensorEventActions& actions) {
+    HalProxyState& state = getHalProxyState();
+    SensorEntry& entry = state.sensorRegistry.addSensor(sensor);
+    entry.actions = actions;
+    state.overflowPolicies.configure(sensor, &entry.overflow);
+    if (entry.isOneShot) {
+        state.activationCache.setUncached(sensor.sensorHandle);
     }
-    /*
-     * Implement only the wake-up version of this sensor.
-     */
-    if (!(sensor.flags & V1_0::SensorFlagBits::WAKE_UP)) {
-        return false;
+    if (actions.needsAlsCorrection) {
+        if (state.alsScreen == nullptr) {
+            state.alsScreen = std::make_shared<AlsScreen>();
+        }
+        entry.alsCorrection = std::make_unique<AlsCorrection>(
+                sensor.name, actions.alsCorrectionPropertyPrefix, state.alsScreen);
+        entry.alsCorrection->start();
     }
-    sensor.type = V2_1::SensorType::GLANCE_GESTURE;
-    sensor.typeAsString = SENSOR_STRING_TYPE_GLANCE_GESTURE;
-    sensor.maxRange = 2;
-    return true;
 }
 
-bool patchOplusPickupSensor(V2_1::SensorInfo& sensor) {
-    if (sensor.typeAsString != "android.sensor.tilt_detector") {
-        return true;
+/**
+ * @return Whether debug() was asked for "--format json" rather than text.
+ */
+static bool isJsonFormatRequested(const hidl_vec<hidl_string>& args) {
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string arg = args[i];
+        if (arg == "--format=json" ||
+            (arg == "--format" && i + 1 < args.size() && std::string(args[i + 1]) == "json")) {
+            return true;
+        }
     }
+    return false;
+}
 
-    /*
-     * Implement only the wake-up version of this sensor.
-     */
-    if (!(sensor.flags & V1_0::SensorFlagBits::WAKE_UP)) {
-        return false;
+/**
+ * Merge the event latency of all static sensors of a sub-HAL.
+ */
+static void getSubHalEventLatency(HalProxyState& state, size_t subHalIndex,
+                                  Log2Histogram* eventLatencyUs) {
+    state.sensorRegistry.forEach([&](const SensorEntry& sensor) {
+        if (extractSubHalIndex(sensor.sensorHandle) == subHalIndex) {
+            eventLatencyUs->merge(sensor.eventLatencyUs);
+        }
+    });
+}
+
+/**
+ * Print a string as a quoted JSON string.
+ */
+static void dumpJsonString(std::ostream& stream, const std::string& value) {
+    stream << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            stream << '\\';
+        }
+        stream << c;
     }
+    stream << '"';
+}
 
-    sensor.type = V2_1::SensorType::PICK_UP_GESTURE;
-    sensor.typeAsString = SENSOR_STRING_TYPE_PICK_UP_GESTURE;
-    sensor.maxRange = 1;
+/**
+ * Print the event pipeline metrics as a single JSON object.
+ */
+static void dumpMetricsJson(std::ostream& stream, HalProxyState& state,
+                            const std::vector<std::string>& subHalNames) {
+    stream << "{\"wakelock\":{\"ref_count\":" << state.sharedWakelock.getRefCount()
+           << ",\"hold_us\":";
+    state.sharedWakelock.holdUs.dumpJson(stream);
+    stream << "},\"lanes\":[";
+    for (size_t i = 0; i < state.pendingWrites.size(); i++) {
+        const PendingWriteLane& lane = state.pendingWrites[i];
+        stream << (i > 0 ? "," : "") << "{\"name\":";
+        dumpJsonString(stream, lane.name);
+        stream << ",\"events\":" << lane.events.size()
+               << ",\"capacity\":" << lane.events.capacity()
+               << ",\"most_pending\":" << lane.mostPending << ",\"spilled\":" << lane.spillSize
+               << ",\"dropped\":" << lane.numDropped << ",\"backlog_us\":";
+        lane.backlogTimeUs.dumpJson(stream);
+        stream << "}";
+    }
+    stream << "],\"reader_wakes\":{\"window_ms\":" << msFromNs(state.readerWake.getWindowNs())
+           << ",\"wakes\":" << state.readerWake.numWakes
+           << ",\"deferred\":" << state.readerWake.numDeferred << "}";
+    stream << ",\"event_batches\":" << state.numEventBatches
+           << ",\"events_posted\":" << state.numEventsPosted
+           << ",\"staging_buffer_growths\":" << state.numStagingBufferGrowths
+           << ",\"batches_written_to_backlog\":" << state.numBatchesWrittenToBacklog
+           << ",\"events_written_from_backlog\":" << state.numEventsWrittenFromBacklog;
+    stream << ",\"subhals\":[";
+    for (size_t i = 0; i < subHalNames.size(); i++) {
+        stream << (i > 0 ? "," : "") << "{\"index\":" << i << ",\"name\":";
+        dumpJsonString(stream, subHalNames[i]);
+        Log2Histogram eventLatencyUs;
+        getSubHalEventLatency(state, i, &eventLatencyUs);
+        stream << ",\"latency_us\":";
+        eventLatencyUs.dumpJson(stream);
+        stream << ",\"watchdog\":";
+        state.watchdog.dumpJson(stream, i);
+        stream << "}";
+    }
+    stream << "],\"sensors\":[";
+    bool first = true;
+    state.sensorRegistry.forEach([&](const SensorEntry& sensor) {
+        stream << (first ? "" : ",") << "{\"handle\":" << sensor.sensorHandle << ",\"name\":";
+        dumpJsonString(stream, sensor.name);
+        stream << ",\"latency_us\":";
+        sensor.eventLatencyUs.dumpJson(stream);
+        stream << "}";
+        first = false;
+    });
+    stream << "]}" << std::endl;
+}
 
-    return true;
+/**
+ * Call function for every sub-HAL index, on a thread per sub-HAL if parallel is set.
+ */
+template <typename Function>
+static void forEachSubHal(size_t numSubHals, bool parallel, Function function) {
+    if (!parallel) {
+        for (size_t i = 0; i < numSubHals; i++) {
+            function(i);
+        }
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numSubHals; i++) {
+        threads.emplace_back(function, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
 }
 
+/**
+ * The event FMQ of the framework, written by the event queue writer of HalProxyState.
+ */
+class FmqEventQueue : public IEventQueue {
+  public:
+    FmqEventQueue(EventMessageQueueWrapperBase* eventQueue, EventFlag* eventQueueFlag)
+        : mEventQueue(eventQueue), mEventQueueFlag(eventQueueFlag) {}
+
+    size_t availableToWrite() override { return mEventQueue->availableToWrite(); }
+
+    size_t getQuantumCount() override { return mEventQueue->getQuantumCount(); }
+
+    bool write(const Event* events, size_t count) override {
+        return mEventQueue->write(events, count);
+    }
+
+    void wakeReader() override {
+        mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+    }
+
+    bool waitForRead(int64_t timeoutNs) override {
+        uint32_t efState = 0;
+        return mEventQueueFlag->wait(static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+                                     &efState, timeoutNs) != TIMED_OUT;
+    }
+
+  private:
+    EventMessageQueueWrapperBase* mEventQueue;
+    EventFlag* mEventQueueFlag;
+};
+
 HalProxy::HalProxy() {
+    getHalProxyState().parallelSubHalStartup =
+            GetBoolProperty("vendor.sensors.parallel_subhal_startup", false);
     static const std::string kMultiHalConfigFiles[] = {"/vendor/etc/sensors/hals.conf",
                                                        "/odm/etc/sensors/hals.conf"};
+    static const std::string kOverflowConfigFiles[] = {"/vendor/etc/sensors/overflow.conf",
+                                                       "/odm/etc/sensors/overflow.conf"};
+    static const std::string kSensorRulesConfigFiles[] = {"/vendor/etc/sensors/sensor_rules.conf",
+                                                          "/odm/etc/sensors/sensor_rules.conf"};
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
     for (const std::string& configFile : kMultiHalConfigFiles) {
         initializeSubHalListFromConfigFile(configFile.c_str());
     }
+    getHalProxyState().loadSubHalsNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    for (const std::string& configFile : kOverflowConfigFiles) {
+        getHalProxyState().overflowPolicies.loadConfigFile(configFile.c_str());
+    }
+    for (const std::string& configFile : kSensorRulesConfigFiles) {
+        getHalProxyState().sensorRules.loadConfigFile(configFile.c_str());
+    }
     init();
 }
 
@@ -191,6 +339,8 @@ Return<Result> HalProxy::setOperationMode(OperationMode mode) {
         }
     } else {
         mCurrentOperationMode = mode;
+        // Sub-HALs may reconfigure their sensors when switching modes.
+        getHalProxyState().activationCache.clear();
     }
     return result;
 }
@@ -199,8 +349,15 @@ Return<Result> HalProxy::activate(int32_t sensorHandle, bool enabled) {
     if (!isSubHalIndexValid(sensorHandle)) {
         return Result::BAD_VALUE;
     }
-    return getSubHalForSensorHandle(sensorHandle)
-            ->activate(clearSubHalIndex(sensorHandle), enabled);
+    ActivationCache& activationCache = getHalProxyState().activationCache;
+    ActivationCache::Call call;
+    if (!activationCache.beginActivate(sensorHandle, enabled, &call)) {
+        return Result::OK;
+    }
+    Result result = getSubHalForSensorHandle(sensorHandle)
+                            ->activate(clearSubHalIndex(sensorHandle), enabled);
+    activationCache.endActivate(sensorHandle, enabled, call, result == Result::OK);
+    return result;
 }
 
 Return<Result> HalProxy::initialize_2_1(
@@ -256,13 +413,15 @@ Return<Result> HalProxy::initializeCommon(
     stopThreads();
     resetSharedWakelock();
 
+    // The framework starts from scratch, so make sure the calls below reach every sub-HAL.
+    getHalProxyState().activationCache.clear();
+
     // So that the pending write events queue can be cleared safely and when we start threads
     // again we do not get new events until after initialize resets the subhals.
     disableAllSensors();
 
     // Clears the queue if any events were pending write before.
-    mPendingWriteEventsQueue = std::queue<std::pair<std::vector<V2_1::Event>, size_t>>();
-    mSizePendingWriteEventsQueue = 0;
+    getHalProxyState().clearPendingWrites();
 
     // Clears previously connected dynamic sensors
     mDynamicSensors.clear();
@@ -291,14 +450,27 @@ Return<Result> HalProxy::initializeCommon(
     if (!mDynamicSensorsCallback || !mEventQueue || !mWakeLockQueue || mEventQueueFlag == nullptr) {
         result = Result::BAD_VALUE;
     }
+    getHalProxyState().eventQueueWriter.setEventQueue(
+            std::make_unique<FmqEventQueue>(mEventQueue.get(), mEventQueueFlag), this);
 
     mThreadsRun.store(true);
 
     mPendingWritesThread = std::thread(startPendingWritesThread, this);
     mWakelockThread = std::thread(startWakelockThread, this);
 
+    // Sub-HALs do not depend on each other, so they may be initialized concurrently.
+    HalProxyState& state = getHalProxyState();
+    state.subHalTimings.resize(mSubHalList.size());
+    std::vector<Result> results(mSubHalList.size());
+    auto initializeSubHal = [&](size_t i) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        results[i] = mSubHalList[i]->initialize(this, this, i);
+        state.subHalTimings[i].initializeNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    };
+    forEachSubHal(mSubHalList.size(), state.parallelSubHalStartup, initializeSubHal);
+
     for (size_t i = 0; i < mSubHalList.size(); i++) {
-        Result currRes = mSubHalList[i]->initialize(this, this, i);
+        Result currRes = results[i];
         if (currRes != Result::OK) {
             result = currRes;
             ALOGE("Subhal '%s' failed to initialize with reason %" PRId32 ".",
@@ -316,8 +488,17 @@ Return<Result> HalProxy::batch(int32_t sensorHandle, int64_t samplingPeriodNs,
     if (!isSubHalIndexValid(sensorHandle)) {
         return Result::BAD_VALUE;
     }
-    return getSubHalForSensorHandle(sensorHandle)
-            ->batch(clearSubHalIndex(sensorHandle), samplingPeriodNs, maxReportLatencyNs);
+    ActivationCache& activationCache = getHalProxyState().activationCache;
+    ActivationCache::Call call;
+    if (!activationCache.beginBatch(sensorHandle, samplingPeriodNs, maxReportLatencyNs, &call)) {
+        return Result::OK;
+    }
+    Result result =
+            getSubHalForSensorHandle(sensorHandle)
+                    ->batch(clearSubHalIndex(sensorHandle), samplingPeriodNs, maxReportLatencyNs);
+    activationCache.endBatch(sensorHandle, samplingPeriodNs, maxReportLatencyNs, call,
+                             result == Result::OK);
+    return result;
 }
 
 Return<Result> HalProxy::flush(int32_t sensorHandle) {
@@ -353,38 +534,63 @@ Return<Result> HalProxy::injectSensorData(const V1_0::Event& event) {
 
 Return<void> HalProxy::registerDirectChannel(const SharedMemInfo& mem,
                                              ISensorsV2_0::registerDirectChannel_cb _hidl_cb) {
-    if (mDirectChannelSubHal == nullptr) {
+    DirectChannelRouter& router = getHalProxyState().directChannelRouter;
+    std::optional<size_t> subHalIndex = router.getSubHalIndex(mem.type);
+    if (!subHalIndex.has_value()) {
         _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
-    } else {
-        mDirectChannelSubHal->registerDirectChannel(mem, _hidl_cb);
+        return Return<void>();
+    }
+
+    Result result = Result::INVALID_OPERATION;
+    DirectChannelRouter::Channel channel = {.subHalIndex = *subHalIndex};
+    mSubHalList[*subHalIndex]->registerDirectChannel(
+            mem, [&](Result registerResult, int32_t subHalChannelHandle) {
+                result = registerResult;
+                channel.subHalChannelHandle = subHalChannelHandle;
+            });
+    if (result != Result::OK) {
+        _hidl_cb(result, -1 /* channelHandle */);
+        return Return<void>();
     }
+    _hidl_cb(Result::OK, router.addChannel(channel));
     return Return<void>();
 }
 
 Return<Result> HalProxy::unregisterDirectChannel(int32_t channelHandle) {
-    Result result;
-    if (mDirectChannelSubHal == nullptr) {
-        result = Result::INVALID_OPERATION;
-    } else {
-        result = mDirectChannelSubHal->unregisterDirectChannel(channelHandle);
+    DirectChannelRouter::Channel channel;
+    if (!getHalProxyState().directChannelRouter.removeChannel(channelHandle, &channel)) {
+        return Result::BAD_VALUE;
     }
-    return result;
+    return mSubHalList[channel.subHalIndex]->unregisterDirectChannel(channel.subHalChannelHandle);
 }
 
 Return<void> HalProxy::configDirectReport(int32_t sensorHandle, int32_t channelHandle,
                                           RateLevel rate,
                                           ISensorsV2_0::configDirectReport_cb _hidl_cb) {
-    if (mDirectChannelSubHal == nullptr) {
-        _hidl_cb(Result::INVALID_OPERATION, -1 /* reportToken */);
-    } else if (sensorHandle == -1 && rate != RateLevel::STOP) {
+    DirectChannelRouter::Channel channel;
+    if (!getHalProxyState().directChannelRouter.findChannel(channelHandle, &channel)) {
         _hidl_cb(Result::BAD_VALUE, -1 /* reportToken */);
-    } else {
+        return Return<void>();
+    }
+
+    if (sensorHandle == -1) {
         // -1 denotes all sensors should be disabled
-        if (sensorHandle != -1) {
-            sensorHandle = clearSubHalIndex(sensorHandle);
+        if (rate != RateLevel::STOP) {
+            _hidl_cb(Result::BAD_VALUE, -1 /* reportToken */);
+            return Return<void>();
         }
-        mDirectChannelSubHal->configDirectReport(sensorHandle, channelHandle, rate, _hidl_cb);
+    } else if (!isSubHalIndexValid(sensorHandle) ||
+               extractSubHalIndex(sensorHandle) != channel.subHalIndex) {
+        // Only sensors of the sub-HAL serving the memory type advertise it.
+        ALOGE("Direct channel %" PRId32 " is served by subhal %zu, cannot add sensor 0x%" PRIx32,
+              channelHandle, channel.subHalIndex, sensorHandle);
+        _hidl_cb(Result::BAD_VALUE, -1 /* reportToken */);
+        return Return<void>();
+    } else {
+        sensorHandle = clearSubHalIndex(sensorHandle);
     }
+    mSubHalList[channel.subHalIndex]->configDirectReport(sensorHandle, channel.subHalChannelHandle,
+                                                         rate, _hidl_cb);
     return Return<void>();
 }
 
@@ -395,31 +601,100 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
     }
 
     int writeFd = fd->data[0];
+    HalProxyState& state = getHalProxyState();
 
     std::ostringstream stream;
+    if (isJsonFormatRequested(args)) {
+        std::vector<std::string> subHalNames;
+        for (const auto& subHal : mSubHalList) {
+            subHalNames.push_back(subHal->getName());
+        }
+        dumpMetricsJson(stream, state, subHalNames);
+        android::base::WriteStringToFd(stream.str(), writeFd);
+        return Return<void>();
+    }
+
     stream << "===HalProxy===" << std::endl;
     stream << "Internal values:" << std::endl;
     stream << "  Threads are running: " << (mThreadsRun.load() ? "true" : "false") << std::endl;
-    int64_t now = getTimeNow();
-    stream << "  Wakelock timeout start time: " << msFromNs(now - mWakelockTimeoutStartTime)
+    SharedWakelock& wakelock = state.sharedWakelock;
+    int64_t now = getBoottimeNs();
+    stream << "  Wakelock timeout start time: " << msFromNs(now - wakelock.getTimeoutStartNs())
            << " ms ago" << std::endl;
-    stream << "  Wakelock timeout reset time: " << msFromNs(now - mWakelockTimeoutResetTime)
+    stream << "  Wakelock timeout reset time: " << msFromNs(now - wakelock.getTimeoutResetNs())
            << " ms ago" << std::endl;
-    // TODO(b/142969448): Add logging for history of wakelock acquisition per subhal.
-    stream << "  Wakelock ref count: " << mWakelockRefCount << std::endl;
-    stream << "  # of events on pending write writes queue: " << mSizePendingWriteEventsQueue
-           << std::endl;
-    stream << " Most events seen on pending write events queue: "
-           << mMostEventsObservedPendingWriteEventsQueue << std::endl;
-    if (!mPendingWriteEventsQueue.empty()) {
-        stream << "  Size of events list on front of pending writes queue: "
-               << mPendingWriteEventsQueue.front().first.size() << std::endl;
+    stream << "  Wakelock ref count: " << wakelock.getRefCount() << std::endl;
+    stream << "  Wakelock hold durations (us):";
+    wakelock.holdUs.dumpText(stream);
+    stream << std::endl;
+    for (const PendingWriteLane& lane : state.pendingWrites) {
+        stream << "  Pending writes lane '" << lane.name << "':" << std::endl;
+        stream << "    # of events: " << lane.events.size() << " (capacity "
+               << lane.events.capacity() << ")" << std::endl;
+        stream << "    Most events seen: " << lane.mostPending << std::endl;
+        stream << "    # of events spilled: " << lane.spillSize << std::endl;
+        stream << "    # of events dropped: " << lane.numDropped << std::endl;
+        stream << "    Time in backlog (us):";
+        lane.backlogTimeUs.dumpText(stream);
+        stream << std::endl;
+    }
+    state.overflowPolicies.dump(stream);
+    state.sensorRules.dump(stream);
+    stream << "  Reader wake window: " << msFromNs(state.readerWake.getWindowNs())
+           << " ms, # of reader wakes: " << state.readerWake.numWakes
+           << ", # of deferred wakes: " << state.readerWake.numDeferred << std::endl;
+    state.activationCache.dump(stream);
+    state.directChannelRouter.dump(stream);
+    stream << "  Startup: subhals " << (state.parallelSubHalStartup ? "in parallel" : "serially")
+           << ", loading subhals took " << msFromNs(state.loadSubHalsNs)
+           << " ms, building the sensor list took " << msFromNs(state.initializeSensorListNs)
+           << " ms" << std::endl;
+    if (state.alsScreen != nullptr) {
+        state.alsScreen->dump(stream);
     }
+    state.sensorRegistry.forEach([&](const SensorEntry& sensor) {
+        if (sensor.alsCorrection != nullptr) {
+            sensor.alsCorrection->dump(stream);
+        }
+    });
+    state.traceRecorder.dump(stream);
+    stream << "  # of event batches posted: " << state.numEventBatches << std::endl;
+    stream << "  # of events posted: " << state.numEventsPosted << std::endl;
+    stream << "  # of staging buffer growths on the event path: "
+           << state.numStagingBufferGrowths << std::endl;
+    stream << "  # of event batches written straight to the backlog: "
+           << state.numBatchesWrittenToBacklog << std::endl;
+    stream << "  # of events written from the backlog: " << state.numEventsWrittenFromBacklog
+           << std::endl;
     stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
     stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
+    stream << "  Event latency, from timestamp to FMQ write (us):" << std::endl;
+    state.sensorRegistry.forEach([&](const SensorEntry& sensor) {
+        if (sensor.eventLatencyUs.getTotal() == 0) {
+            return;
+        }
+        stream << "    " << sensor.name << " (0x" << std::hex << sensor.sensorHandle << std::dec
+               << "): p50 <" << sensor.eventLatencyUs.getPercentile(0.5) << ", p99 <"
+               << sensor.eventLatencyUs.getPercentile(0.99) << ",";
+        sensor.eventLatencyUs.dumpText(stream);
+        stream << std::endl;
+    });
     stream << "SubHals (" << mSubHalList.size() << "):" << std::endl;
-    for (auto& subHal : mSubHalList) {
+    for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
+        auto& subHal = mSubHalList[subHalIndex];
         stream << "  Name: " << subHal->getName() << std::endl;
+        state.activationCache.dumpSubHal(stream, subHalIndex);
+        state.watchdog.dump(stream, subHalIndex);
+        Log2Histogram eventLatencyUs;
+        getSubHalEventLatency(state, subHalIndex, &eventLatencyUs);
+        stream << "  Event latency (us): p50 <" << eventLatencyUs.getPercentile(0.5) << ", p99 <"
+               << eventLatencyUs.getPercentile(0.99) << std::endl;
+        if (subHalIndex < state.subHalTimings.size()) {
+            const SubHalStartupTiming& timing = state.subHalTimings[subHalIndex];
+            stream << "  Startup: loading took " << msFromNs(timing.loadNs)
+                   << " ms, initialize took " << msFromNs(timing.initializeNs) << " ms"
+                   << std::endl;
+        }
         stream << "  Debug dump: " << std::endl;
         android::base::WriteStringToFd(stream.str(), writeFd);
         subHal->debug(fd, args);
@@ -442,6 +717,10 @@ Return<void> HalProxy::onDynamicSensorsConnected(const hidl_vec<SensorInfo>& dyn
             } else {
                 sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
                 mDynamicSensors[sensor.sensorHandle] = sensor;
+                if ((sensor.flags & V1_0::SensorFlagBits::MASK_REPORTING_MODE) ==
+                    static_cast<uint32_t>(V1_0::SensorFlagBits::ONE_SHOT_MODE)) {
+                    getHalProxyState().activationCache.setUncached(sensor.sensorHandle);
+                }
                 sensors.push_back(sensor);
             }
         }
@@ -463,6 +742,7 @@ Return<void> HalProxy::onDynamicSensorsDisconnected(
                 sensorHandle = setSubHalIndex(sensorHandle, subHalIndex);
                 if (mDynamicSensors.find(sensorHandle) != mDynamicSensors.end()) {
                     mDynamicSensors.erase(sensorHandle);
+                    getHalProxyState().activationCache.forget(sensorHandle);
                     sensorHandles.push_back(sensorHandle);
                 }
             }
@@ -472,53 +752,86 @@ Return<void> HalProxy::onDynamicSensorsDisconnected(
     return Return<void>();
 }
 
+/**
+ * Get the sub-HAL exported by a loaded sub-HAL library.
+ *
+ * @return nullptr if the library does not export a supported sub-HAL.
+ */
+static std::shared_ptr<ISubHalWrapperBase> getSubHalFromLibrary(
+        void* handle, const std::string& subHalLibraryFile) {
+    SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
+            (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
+    if (sensorsHalGetSubHalPtr != nullptr) {
+        std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal = *sensorsHalGetSubHalPtr;
+        uint32_t version;
+        ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
+        if (version != SUB_HAL_2_0_VERSION) {
+            ALOGE("SubHal version was not 2.0 for library: %s", subHalLibraryFile.c_str());
+        } else {
+            ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+            return std::make_shared<SubHalWrapperV2_0>(subHal);
+        }
+    } else {
+        SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
+                (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
+
+        if (getSubHalV2_1Ptr == nullptr) {
+            ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
+                  subHalLibraryFile.c_str());
+        } else {
+            std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 = *getSubHalV2_1Ptr;
+            uint32_t version;
+            ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
+            if (version != SUB_HAL_2_1_VERSION) {
+                ALOGE("SubHal version was not 2.1 for library: %s", subHalLibraryFile.c_str());
+            } else {
+                ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+                return std::make_shared<SubHalWrapperV2_1>(subHal);
+            }
+        }
+    }
+    return nullptr;
+}
+
 void HalProxy::initializeSubHalListFromConfigFile(const char* configFileName) {
     std::ifstream subHalConfigStream(configFileName);
     if (!subHalConfigStream) {
         ALOGE("Failed to load subHal config file: %s", configFileName);
-    } else {
-        std::string subHalLibraryFile;
-        while (subHalConfigStream >> subHalLibraryFile) {
-            void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
-            if (handle == nullptr) {
-                ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
-            } else {
-                SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
-                        (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
-                if (sensorsHalGetSubHalPtr != nullptr) {
-                    std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal =
-                            *sensorsHalGetSubHalPtr;
-                    uint32_t version;
-                    ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
-                    if (version != SUB_HAL_2_0_VERSION) {
-                        ALOGE("SubHal version was not 2.0 for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                        mSubHalList.push_back(std::make_unique<SubHalWrapperV2_0>(subHal));
-                    }
-                } else {
-                    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
-                            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
-
-                    if (getSubHalV2_1Ptr == nullptr) {
-                        ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 =
-                                *getSubHalV2_1Ptr;
-                        uint32_t version;
-                        ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
-                        if (version != SUB_HAL_2_1_VERSION) {
-                            ALOGE("SubHal version was not 2.1 for library: %s",
-                                  subHalLibraryFile.c_str());
-                        } else {
-                            ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                            mSubHalList.push_back(std::make_unique<SubHalWrapperV2_1>(subHal));
-                        }
-                    }
-                }
-            }
+        return;
+    }
+
+    auto loadSubHal = [this](const std::string& subHalLibraryFile) {
+        void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
+        if (handle == nullptr) {
+            ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
+            return std::shared_ptr<ISubHalWrapperBase>();
+        }
+        return getSubHalFromLibrary(handle, subHalLibraryFile);
+    };
+
+    std::vector<std::string> subHalLibraryFiles;
+    std::string subHalLibraryFile;
+    while (subHalConfigStream >> subHalLibraryFile) {
+        subHalLibraryFiles.push_back(subHalLibraryFile);
+    }
+
+    // Libraries may be loaded concurrently, but are added in config file order so that sensor
+    // handles do not depend on which one finished first.
+    std::vector<std::shared_ptr<ISubHalWrapperBase>> subHals(subHalLibraryFiles.size());
+    std::vector<int64_t> loadNs(subHalLibraryFiles.size());
+    auto load = [&](size_t i) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        subHals[i] = loadSubHal(subHalLibraryFiles[i]);
+        loadNs[i] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    };
+    HalProxyState& state = getHalProxyState();
+    forEachSubHal(subHalLibraryFiles.size(), state.parallelSubHalStartup, load);
+
+    for (size_t i = 0; i < subHals.size(); i++) {
+        if (subHals[i] != nullptr) {
+            mSubHalList.push_back(subHals[i]);
+            state.subHalTimings.resize(mSubHalList.size());
+            state.subHalTimings.back().loadNs = loadNs[i];
         }
     }
 }
@@ -532,17 +845,13 @@ void HalProxy::initializeSensorList() {
                 } else {
                     ALOGV("Loaded sensor: %s", sensor.name.c_str());
                     sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
-                    setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
-                    if (static_cast<int>(sensor.type) == SENSOR_TYPE_QTI_WISE_LIGHT) {
-                        sensor.type = V2_1::SensorType::LIGHT;
-                        sensor.typeAsString = SENSOR_STRING_TYPE_LIGHT;
-                        AlsCorrection::init();
-                    }
-                    bool keep = patchOplusPickupSensor(sensor) && patchOplusGlanceSensor(sensor);
-                    if (!keep) {
+                    getHalProxyState().directChannelRouter.addSensor(subHalIndex, &sensor);
+                    SensorEventActions actions;
+                    if (!getHalProxyState().sensorRules.apply(sensor, &actions)) {
                         continue;
                     }
                     mSensors[sensor.sensorHandle] = sensor;
+                    addSensorEntry(sensor, actions);
                 }
             }
         });
@@ -573,7 +882,19 @@ void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename) {
 }
 
 void HalProxy::init() {
+    getHalProxyState().setNumSubHals(mSubHalList.size());
+    getHalProxyState().sharedWakelock.init(kWakelockName, kWakelockTimeoutNs);
+    getHalProxyState().readerWake.setWindowNs(
+            GetIntProperty("vendor.sensors.reader_wake_window_ms", 0) * INT64_C(1000000));
+    getHalProxyState().sensorRules.loadDefaultsIfNeeded();
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
     initializeSensorList();
+    getHalProxyState().initializeSensorListNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    std::string traceFile = GetProperty("vendor.sensors.trace_file", "");
+    if (!traceFile.empty()) {
+        getHalProxyState().traceRecorder.start(traceFile, mSensors);
+    }
 }
 
 void HalProxy::stopThreads() {
@@ -589,8 +910,8 @@ void HalProxy::stopThreads() {
         mWakeLockQueue->write(&kZero);
         mWakelockQueueFlag->wake(static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN));
     }
-    mWakelockCV.notify_one();
-    mEventQueueWriteCV.notify_one();
+    getHalProxyState().sharedWakelock.acquiredSignal.forceNotify();
+    getHalProxyState().pendingWritesSignal.forceNotify();
     if (mPendingWritesThread.joinable()) {
         mPendingWritesThread.join();
     }
@@ -616,45 +937,7 @@ void HalProxy::startPendingWritesThread(HalProxy* halProxy) {
 }
 
 void HalProxy::handlePendingWrites() {
-    // TODO(b/143302327): Find a way to optimize locking strategy maybe using two mutexes instead of
-    // one.
-    std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
-    while (mThreadsRun.load()) {
-        mEventQueueWriteCV.wait(
-                lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
-        if (mThreadsRun.load()) {
-            std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-            size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-            size_t eventQueueSize = mEventQueue->getQuantumCount();
-            size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
-            lock.unlock();
-            if (!mEventQueue->writeBlocking(
-                        pendingWriteEvents.data(), numToWrite,
-                        static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
-                        static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
-                        kPendingWriteTimeoutNs, mEventQueueFlag)) {
-                ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
-                if (numWakeupEvents > 0) {
-                    if (pendingWriteEvents.size() > eventQueueSize) {
-                        decrementRefCountAndMaybeReleaseWakelock(
-                                countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-                    } else {
-                        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-                    }
-                }
-            }
-            lock.lock();
-            mSizePendingWriteEventsQueue -= numToWrite;
-            if (pendingWriteEvents.size() > eventQueueSize) {
-                // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-                // all the events ahead of it down to fill gap off array at front after the erase.
-                pendingWriteEvents.erase(pendingWriteEvents.begin(),
-                                         pendingWriteEvents.begin() + eventQueueSize);
-            } else {
-                mPendingWriteEventsQueue.pop();
-            }
-        }
-    }
+    getHalProxyState().eventQueueWriter.handlePendingWrites(mThreadsRun);
 }
 
 void HalProxy::startWakelockThread(HalProxy* halProxy) {
@@ -662,20 +945,19 @@ void HalProxy::startWakelockThread(HalProxy* halProxy) {
 }
 
 void HalProxy::handleWakelocks() {
-    std::unique_lock<std::recursive_mutex> lock(mWakelockMutex);
+    SharedWakelock& wakelock = getHalProxyState().sharedWakelock;
     while (mThreadsRun.load()) {
-        mWakelockCV.wait(lock, [&] { return mWakelockRefCount > 0 || !mThreadsRun.load(); });
-        if (mThreadsRun.load()) {
+        wakelock.acquiredSignal.wait(
+                [&] { return wakelock.getRefCount() > 0 || !mThreadsRun.load(); });
+        if (mThreadsRun.load() && wakelock.getRefCount() > 0) {
             int64_t timeLeft;
             if (sharedWakelockDidTimeout(&timeLeft)) {
                 resetSharedWakelock();
             } else {
                 uint32_t numWakeLocksProcessed;
-                lock.unlock();
                 bool success = mWakeLockQueue->readBlocking(
                         &numWakeLocksProcessed, 1, 0,
                         static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), timeLeft);
-                lock.lock();
                 if (success) {
                     decrementRefCountAndMaybeReleaseWakelock(
                             static_cast<size_t>(numWakeLocksProcessed));
@@ -687,72 +969,29 @@ void HalProxy::handleWakelocks() {
 }
 
 bool HalProxy::sharedWakelockDidTimeout(int64_t* timeLeft) {
-    bool didTimeout;
-    int64_t duration = getTimeNow() - mWakelockTimeoutStartTime;
-    if (duration > kWakelockTimeoutNs) {
-        didTimeout = true;
-    } else {
-        didTimeout = false;
-        *timeLeft = kWakelockTimeoutNs - duration;
-    }
-    return didTimeout;
+    return getHalProxyState().sharedWakelock.didTimeout(timeLeft);
 }
 
 void HalProxy::resetSharedWakelock() {
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    decrementRefCountAndMaybeReleaseWakelock(mWakelockRefCount);
-    mWakelockTimeoutResetTime = getTimeNow();
+    getHalProxyState().sharedWakelock.reset();
 }
 
 void HalProxy::postEventsToMessageQueue(const std::vector<Event>& eventsList, size_t numWakeupEvents,
                                         V2_0::implementation::ScopedWakelock wakelock) {
-    size_t numToWrite = 0;
-    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
     if (wakelock.isLocked()) {
         incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
     }
-    std::vector<Event> events(eventsList);
-    for (auto& event : events) {
-        if (static_cast<int>(event.sensorType) == SENSOR_TYPE_QTI_WISE_LIGHT) {
-            AlsCorrection::process(event);
-        }
-    }
-    if (mPendingWriteEventsQueue.empty()) {
-        numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
-        if (numToWrite > 0) {
-            if (mEventQueue->write(events.data(), numToWrite)) {
-                // TODO(b/143302327): While loop if mEventQueue->avaiableToWrite > 0 to possibly fit
-                // in more writes immediately
-                mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
-            } else {
-                numToWrite = 0;
-            }
-        }
-    }
-    size_t numLeft = events.size() - numToWrite;
-    if (numToWrite < events.size() &&
-        mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-        std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-        mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
-        mSizePendingWriteEventsQueue += numLeft;
-        mMostEventsObservedPendingWriteEventsQueue =
-                std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
-        mEventQueueWriteCV.notify_one();
-    }
+    // The callback already rewrote the events in a buffer it reuses, use them as they are. It also
+    // ordered them so that the wake up events come first.
+    getHalProxyState().eventQueueWriter.postEvents(eventsList, numWakeupEvents);
 }
 
 bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
                                                         int64_t* timeoutStart /* = nullptr */) {
     if (!mThreadsRun.load()) return false;
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (mWakelockRefCount == 0) {
-        acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakelockName);
-        mWakelockCV.notify_one();
-    }
-    mWakelockTimeoutStartTime = getTimeNow();
-    mWakelockRefCount += delta;
+    int64_t start = getHalProxyState().sharedWakelock.acquire(delta);
     if (timeoutStart != nullptr) {
-        *timeoutStart = mWakelockTimeoutStartTime;
+        *timeoutStart = start;
     }
     return true;
 }
@@ -760,32 +999,7 @@ bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
 void HalProxy::decrementRefCountAndMaybeReleaseWakelock(size_t delta,
                                                         int64_t timeoutStart /* = -1 */) {
     if (!mThreadsRun.load()) return;
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (delta > mWakelockRefCount) {
-        ALOGE("Decrementing wakelock ref count by %zu when count is %zu",
-              delta, mWakelockRefCount);
-    }
-    if (timeoutStart == -1) timeoutStart = mWakelockTimeoutResetTime;
-    if (mWakelockRefCount == 0 || timeoutStart < mWakelockTimeoutResetTime) return;
-    mWakelockRefCount -= std::min(mWakelockRefCount, delta);
-    if (mWakelockRefCount == 0) {
-        release_wake_lock(kWakelockName);
-    }
-}
-
-void HalProxy::setDirectChannelFlags(SensorInfo* sensorInfo,
-                                     std::shared_ptr<ISubHalWrapperBase> subHal) {
-    bool sensorSupportsDirectChannel =
-            (sensorInfo->flags & (V1_0::SensorFlagBits::MASK_DIRECT_REPORT |
-                                  V1_0::SensorFlagBits::MASK_DIRECT_CHANNEL)) != 0;
-    if (mDirectChannelSubHal == nullptr && sensorSupportsDirectChannel) {
-        mDirectChannelSubHal = subHal;
-    } else if (mDirectChannelSubHal != nullptr && subHal != mDirectChannelSubHal) {
-        // disable direct channel capability for sensors in subHals that are not
-        // the only one we will enable
-        sensorInfo->flags &= ~(V1_0::SensorFlagBits::MASK_DIRECT_REPORT |
-                               V1_0::SensorFlagBits::MASK_DIRECT_CHANNEL);
-    }
+    getHalProxyState().sharedWakelock.release(delta, timeoutStart);
 }
 
 std::shared_ptr<ISubHalWrapperBase> HalProxy::getSubHalForSensorHandle(int32_t sensorHandle) {
@@ -798,9 +1012,10 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
 
 size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
     size_t numWakeupEvents = 0;
+    SensorRegistry& registry = getHalProxyState().sensorRegistry;
     for (size_t i = 0; i < n; i++) {
-        int32_t sensorHandle = events[i].sensorHandle;
-        if (mSensors[sensorHandle].flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) {
+        SensorEntry* entry = registry.find(events[i].sensorHandle);
+        if (entry != nullptr && entry->isWakeup) {
             numWakeupEvents++;
         }
     }
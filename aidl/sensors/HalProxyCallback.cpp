@@ -16,8 +16,13 @@
 
 #include "HalProxyCallback.h"
 
+#include "AlsCorrection.h"
+#include "HalProxyState.h"
+
+#include <unistd.h>
+
+#include <algorithm>
 #include <cinttypes>
-#include <fstream>
 
 namespace android {
 namespace hardware {
@@ -39,11 +44,182 @@ int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex) {
     return sensorHandle | (static_cast<int32_t>(subHalIndex) << kBitsAfterSubHalIndex);
 }
 
+/**
+ * @return Whether the event is a sample of its sensor rather than a meta event about it.
+ */
+static bool isDataEvent(const V2_1::Event& event) {
+    return event.sensorType != V2_1::SensorType::META_DATA &&
+           event.sensorType != V2_1::SensorType::ADDITIONAL_INFO &&
+           event.sensorType != V2_1::SensorType::DYNAMIC_SENSOR_META;
+}
+
+/**
+ * Rewrite a single event coming from a sub-HAL in place.
+ *
+ * @return false if the event must not be forwarded to the framework.
+ */
+static bool processEvent(int32_t subHalIndex, V2_1::Event& event, size_t* numWakeupEvents) {
+    V2_1::implementation::SensorEntry* sensor =
+            V2_1::implementation::getHalProxyState().sensorRegistry.find(subHalIndex,
+                                                                         event.sensorHandle);
+    event.sensorHandle = setSubHalIndex(event.sensorHandle, subHalIndex);
+    if (event.sensorType == V2_1::SensorType::DYNAMIC_SENSOR_META) {
+        event.u.dynamic.sensorHandle = setSubHalIndex(event.u.dynamic.sensorHandle, subHalIndex);
+    }
+    if (sensor == nullptr) {
+        // Dynamic sensors have none of the quirks below.
+        return true;
+    }
+
+    // Flush complete and additional info events carry the handle of their sensor too, but their
+    // payload is not a sample. The quirks below must leave them alone.
+    if (isDataEvent(event)) {
+        const V2_1::implementation::SensorEventActions& actions = sensor->actions;
+        if (actions.hasValueFilter && event.u.scalar != actions.filterValue) {
+            return false;
+        }
+
+        if (actions.nodeFd >= 0) {
+            char value = ((event.u.scalar != 0) != actions.nodeInverted) ? '1' : '0';
+            pwrite(actions.nodeFd, &value, sizeof(value), 0);
+        }
+
+        if (sensor->alsCorrection != nullptr && !sensor->alsCorrection->process(event)) {
+            return false;
+        }
+    }
+
+    if (sensor->isWakeup) {
+        (*numWakeupEvents)++;
+    }
+    return true;
+}
+
+/**
+ * Copy processed events straight into the backlog, skipping HalProxy and its staging.
+ *
+ * Slots are only reserved once the events are processed, for exactly the events that survived.
+ * Processing may block, on the ALS correction or on a sysfs write, and the pending writes thread
+ * cannot drain past a reservation that is not committed yet, so holding one meanwhile would stall
+ * every sub-HAL behind this one.
+ *
+ * @param events Processed events, wake up events first.
+ *
+ * @return false if the backlog has no room, in which case nothing was consumed.
+ */
+static bool postEventsToBacklog(IScopedWakelockRefCounter* refCounter, int32_t subHalIndex,
+                                const std::vector<V2_1::Event>& events, size_t numWakeupEvents,
+                                const ScopedWakelock& wakelock) {
+    using V2_1::implementation::kWakeupLane;
+
+    V2_1::implementation::HalProxyState& state = V2_1::implementation::getHalProxyState();
+    auto& wakeupLane = state.pendingWrites[kWakeupLane];
+    auto& nonWakeupLane = state.pendingWrites[state.getSubHalLaneIndex(subHalIndex)];
+    size_t numNonWakeupEvents = events.size() - numWakeupEvents;
+
+    V2_1::implementation::EventRing<V2_1::Event>::Reservation wakeupReservation;
+    if (numWakeupEvents > 0) {
+        wakeupReservation = wakeupLane.events.reserve(numWakeupEvents);
+        if (!wakeupReservation) {
+            return false;
+        }
+    }
+    V2_1::implementation::EventRing<V2_1::Event>::Reservation nonWakeupReservation;
+    if (numNonWakeupEvents > 0) {
+        nonWakeupReservation = nonWakeupLane.events.reserve(numNonWakeupEvents);
+        if (!nonWakeupReservation) {
+            if (wakeupReservation) {
+                wakeupLane.events.commit(wakeupReservation, 0);
+                state.pendingWritesSignal.notify();
+            }
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < numWakeupEvents; i++) {
+        wakeupLane.events.slot(wakeupReservation, i) = events[i];
+    }
+    for (size_t i = 0; i < numNonWakeupEvents; i++) {
+        nonWakeupLane.events.slot(nonWakeupReservation, i) = events[numWakeupEvents + i];
+    }
+
+    // The framework may acknowledge these as soon as they are committed, so account for them
+    // first.
+    if (numWakeupEvents > 0 && wakelock.isLocked()) {
+        refCounter->incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
+    }
+    int64_t now = V2_1::implementation::getMonotonicTimeNs();
+    if (wakeupReservation) {
+        wakeupLane.events.commit(wakeupReservation, numWakeupEvents, now);
+        state.onPendingWritesQueued(wakeupLane);
+    }
+    if (nonWakeupReservation) {
+        nonWakeupLane.events.commit(nonWakeupReservation, numNonWakeupEvents, now);
+        state.onPendingWritesQueued(nonWakeupLane);
+    }
+    state.numBatchesWrittenToBacklog++;
+    return true;
+}
+
 void HalProxyCallbackBase::postEvents(const std::vector<V2_1::Event>& events,
                                       ScopedWakelock wakelock) {
     if (events.empty() || !mCallback->areThreadsRunning()) return;
-    size_t numWakeupEvents;
-    std::vector<V2_1::Event> processedEvents = processEvents(events, &numWakeupEvents);
+
+    V2_1::implementation::HalProxyState& state = V2_1::implementation::getHalProxyState();
+    if (state.traceRecorder.isRecording()) {
+        state.traceRecorder.recordBatch(mSubHalIndex, events, wakelock.isLocked(),
+                                        state.sharedWakelock.getRefCount());
+    }
+    V2_1::implementation::ScopedCallbackTimer callbackTimer(state.watchdog, mSubHalIndex,
+                                                            events.size());
+    state.numEventBatches++;
+    state.numEventsPosted += events.size();
+
+    // Reused across batches so the steady state does not allocate; only growing it does.
+    thread_local std::vector<V2_1::Event> processedEvents;
+    if (processedEvents.capacity() < events.size()) {
+        state.numStagingBufferGrowths++;
+    }
+    processedEvents.assign(events.begin(), events.end());
+
+    size_t numWakeupEvents = 0;
+    size_t numKept = 0;
+    for (size_t i = 0; i < processedEvents.size(); i++) {
+        if (processEvent(mSubHalIndex, processedEvents[i], &numWakeupEvents)) {
+            if (numKept != i) {
+                processedEvents[numKept] = processedEvents[i];
+            }
+            numKept++;
+        }
+    }
+    processedEvents.resize(numKept);
+    if (numKept == 0) {
+        return;
+    }
+
+    // HalProxy and the backlog expect the wake up events first so that they can take the priority
+    // lane. Batches rarely mix both kinds, so only pay for the reordering when they do.
+    if (numWakeupEvents > 0 && numWakeupEvents < numKept) {
+        thread_local std::vector<V2_1::Event> nonWakeupEvents;
+        if (nonWakeupEvents.capacity() < numKept) {
+            state.numStagingBufferGrowths++;
+        }
+        nonWakeupEvents.clear();
+        size_t numWakeupKept = 0;
+        for (const V2_1::Event& event : processedEvents) {
+            V2_1::implementation::SensorEntry* sensor =
+                    state.sensorRegistry.find(event.sensorHandle);
+            if (sensor != nullptr && sensor->isWakeup) {
+                processedEvents[numWakeupKept++] = event;
+            } else {
+                nonWakeupEvents.push_back(event);
+            }
+        }
+        std::copy(nonWakeupEvents.begin(), nonWakeupEvents.end(),
+                  processedEvents.begin() + numWakeupKept);
+    }
+
+    state.watchdog.onWakeupEvents(mSubHalIndex, numWakeupEvents);
     if (numWakeupEvents > 0) {
         ALOG_ASSERT(wakelock.isLocked(),
                     "Wakeup events posted while wakelock unlocked for subhal"
@@ -55,6 +231,15 @@ void HalProxyCallbackBase::postEvents(const std::vector<V2_1::Event>& events,
                     " w/ index %" PRId32 ".",
                     mSubHalIndex);
     }
+
+    // While the FMQ is backed up these events can only go to the backlog, so put them there
+    // directly instead of going through HalProxy. Once the backlog is under pressure they take
+    // the regular path, which applies the per sensor overflow policies.
+    if (state.hasPendingWrites() && state.isBacklogRelaxed() &&
+        postEventsToBacklog(mRefCounter, mSubHalIndex, processedEvents, numWakeupEvents,
+                            wakelock)) {
+        return;
+    }
     mCallback->postEventsToMessageQueue(processedEvents, numWakeupEvents, std::move(wakelock));
 }
 
@@ -63,45 +248,6 @@ ScopedWakelock HalProxyCallbackBase::createScopedWakelock(bool lock) {
     return wakelock;
 }
 
-std::vector<V2_1::Event> HalProxyCallbackBase::processEvents(const std::vector<V2_1::Event>& events,
-                                                             size_t* numWakeupEvents) const {
-    *numWakeupEvents = 0;
-    std::vector<V2_1::Event> eventsOut;
-    const char* aodLightModeNode = "/sys/kernel/oplus_display/aod_light_mode_set";
-    for (V2_1::Event event : events) {
-        event.sensorHandle = setSubHalIndex(event.sensorHandle, mSubHalIndex);
-        if (event.sensorType == V2_1::SensorType::DYNAMIC_SENSOR_META) {
-            event.u.dynamic.sensorHandle =
-                    setSubHalIndex(event.u.dynamic.sensorHandle, mSubHalIndex);
-        }
-        const V2_1::SensorInfo& sensor = mCallback->getSensorInfo(event.sensorHandle);
-
-        if (sensor.type == V2_1::SensorType::GLANCE_GESTURE
-            && event.u.scalar != 2) {
-            continue;
-        }
-
-        if (sensor.type == V2_1::SensorType::PICK_UP_GESTURE
-            && event.u.scalar != 0) {
-            continue;
-        }
-
-        if (sensor.typeAsString == "qti.sensor.lux_aod") {
-            std::ofstream nodeFile(aodLightModeNode);
-            if (nodeFile.is_open()) {
-                nodeFile << !event.u.scalar;
-                nodeFile.close();
-            }
-        }
-
-        if ((sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0) {
-            (*numWakeupEvents)++;
-        }
-        eventsOut.push_back(event);
-    }
-    return eventsOut;
-}
-
 }  // namespace implementation
 }  // namespace V2_0
 }  // namespace sensors
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "HalProxyState.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+bool ReaderWakeCoalescer::shouldWakeNow(bool urgent) {
+    if (urgent || !isEnabled() || getMonotonicTimeNs() - mLastWakeNs.load() >= mWindowNs) {
+        return true;
+    }
+    mWakeDeferred.store(true);
+    numDeferred++;
+    return false;
+}
+
+void ReaderWakeCoalescer::onWake() {
+    mLastWakeNs.store(getMonotonicTimeNs());
+    mWakeDeferred.store(false);
+    numWakes++;
+}
+
+int64_t ReaderWakeCoalescer::getDeferredWakeDelayNs() const {
+    if (!mWakeDeferred.load()) {
+        return -1;
+    }
+    int64_t elapsedNs = getMonotonicTimeNs() - mLastWakeNs.load();
+    return std::max<int64_t>(0, mWindowNs - elapsedNs);
+}
+
+static constexpr size_t kWakeupLaneCapacity = 4096;
+static constexpr size_t kSubHalLaneCapacity = 8192;
+// NEVER_DROP sensors are the rare ones, so their spill is a fraction of the ring.
+static constexpr size_t kWakeupLaneSpillCapacity = 1024;
+static constexpr size_t kSubHalLaneSpillCapacity = 256;
+
+HalProxyState::HalProxyState() {
+    pendingWrites.emplace_back("wake up", kWakeupLaneCapacity, kWakeupLaneSpillCapacity);
+    // Until the sub-HALs are known, everything goes through a single non-wake up lane.
+    setNumSubHals(1);
+}
+
+void HalProxyState::setNumSubHals(size_t numSubHals) {
+    while (getNumSubHalLanes() < numSubHals) {
+        pendingWrites.emplace_back("non-wake up, subhal " + std::to_string(getNumSubHalLanes()),
+                                   kSubHalLaneCapacity, kSubHalLaneSpillCapacity);
+    }
+    watchdog.setNumSubHals(numSubHals);
+}
+
+bool HalProxyState::hasPendingWrites() const {
+    for (const PendingWriteLane& lane : pendingWrites) {
+        if (!lane.events.empty() || lane.spillSize > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isLaneWritable(const PendingWriteLane& lane) {
+    return lane.events.empty() ? lane.spillSize > 0 : lane.events.isHeadCommitted();
+}
+
+bool HalProxyState::hasCommittedPendingWrites() const {
+    const PendingWriteLane& wakeupLane = pendingWrites[kWakeupLane];
+    if (!wakeupLane.events.empty() || wakeupLane.spillSize > 0) {
+        return isLaneWritable(wakeupLane);
+    }
+    for (size_t i = kFirstSubHalLane; i < pendingWrites.size(); i++) {
+        if (isLaneWritable(pendingWrites[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HalProxyState::hasUrgentEvents(const Event* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const SensorEntry* sensor = sensorRegistry.find(events[i].sensorHandle);
+        if (sensor != nullptr && (sensor->isWakeup || sensor->isOneShot)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HalProxyState::isBacklogRelaxed() const {
+    for (const PendingWriteLane& lane : pendingWrites) {
+        if (lane.isUnderPressure() || lane.spillSize > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void HalProxyState::onEventsWritten(PendingWriteLane* lane, const Event* events, size_t count) {
+    int64_t now = getMonotonicTimeNs();
+    if (lane != nullptr) {
+        for (size_t i = 0; i < count; i++) {
+            lane->backlogTimeUs.record((now - lane->events.getStamp(&events[i])) / kNsPerUs);
+        }
+    }
+
+    // Event timestamps use the boot time clock.
+    int64_t bootTimeNs = getBoottimeNs();
+    for (size_t i = 0; i < count; i++) {
+        const Event& event = events[i];
+        if (event.timestamp <= 0 || event.timestamp > bootTimeNs) {
+            continue;
+        }
+        SensorEntry* sensor = sensorRegistry.find(event.sensorHandle);
+        if (sensor != nullptr) {
+            sensor->eventLatencyUs.record((bootTimeNs - event.timestamp) / kNsPerUs);
+        }
+    }
+}
+
+void HalProxyState::onPendingWritesQueued(PendingWriteLane& lane) {
+    size_t numPending = lane.events.size();
+    size_t mostPending = lane.mostPending.load(std::memory_order_relaxed);
+    while (numPending > mostPending &&
+           !lane.mostPending.compare_exchange_weak(mostPending, numPending)) {
+    }
+    pendingWritesSignal.notify();
+}
+
+size_t HalProxyState::queuePendingWrites(size_t laneIndex, const Event* events, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    PendingWriteLane& lane = pendingWrites[laneIndex];
+    int64_t now = getMonotonicTimeNs();
+    if (!lane.isUnderPressure() && lane.spillSize == 0 && lane.events.push(events, count, now)) {
+        onPendingWritesQueued(lane);
+        return 0;
+    }
+
+    // Slow path, look at every event's policy. Claim whatever room is left in the ring.
+    size_t room = lane.events.capacity() - std::min(lane.events.capacity(), lane.events.size());
+    auto reservation = lane.events.reserve(std::min(count, room));
+    bool underPressure = lane.isUnderPressure();
+    size_t numQueued = 0;
+    size_t numSpilled = 0;
+    size_t numNotQueued = 0;
+    std::unique_lock<std::mutex> spillLock(lane.spillMutex, std::defer_lock);
+    for (size_t i = 0; i < count; i++) {
+        const Event& event = events[i];
+        SensorEntry* entry = sensorRegistry.find(event.sensorHandle);
+        SensorOverflowState* sensor = entry != nullptr ? &entry->overflow : nullptr;
+        OverflowPolicy policy = sensor != nullptr ? sensor->policy : OverflowPolicy::DROP_NEWEST;
+        OverflowPolicyCounters& counters = overflowPolicies.getCounters(policy);
+
+        if (policy == OverflowPolicy::NEVER_DROP &&
+            (lane.spillSize > 0 || numQueued == reservation.count)) {
+            if (!spillLock.owns_lock()) {
+                spillLock.lock();
+            }
+            size_t spillSize = lane.spillSize.load(std::memory_order_relaxed);
+            if (spillSize < lane.spillCapacity) {
+                lane.spill[(lane.spillHead + spillSize) % lane.spillCapacity] = event;
+                lane.spillSize.store(spillSize + 1);
+                counters.numSpilled++;
+                numSpilled++;
+            } else {
+                counters.numDropped++;
+                numNotQueued++;
+            }
+        } else if (policy == OverflowPolicy::DECIMATE && underPressure &&
+                   !sensor->keepUnderPressure()) {
+            counters.numDecimated++;
+            numNotQueued++;
+        } else if (numQueued < reservation.count) {
+            lane.events.slot(reservation, numQueued++) = event;
+        } else {
+            counters.numDropped++;
+            numNotQueued++;
+        }
+    }
+    if (spillLock.owns_lock()) {
+        spillLock.unlock();
+    }
+    if (reservation) {
+        lane.events.commit(reservation, numQueued, now);
+    }
+    lane.numDropped += numNotQueued;
+    // Even an unused reservation may be what the pending writes thread is waiting on.
+    if (reservation || numSpilled > 0) {
+        onPendingWritesQueued(lane);
+    }
+    return numNotQueued;
+}
+
+size_t HalProxyState::evictOldest(PendingWriteLane& lane) {
+    size_t numEvicted = 0;
+    OverflowPolicyCounters& counters = overflowPolicies.getCounters(OverflowPolicy::DROP_OLDEST);
+    while (lane.isAboveHighWater()) {
+        Event* events;
+        size_t count = lane.events.peek(lane.events.capacity(), &events);
+        size_t numOldest = 0;
+        while (numOldest < count) {
+            SensorEntry* entry = sensorRegistry.find(events[numOldest].sensorHandle);
+            if (entry == nullptr || entry->overflow.policy != OverflowPolicy::DROP_OLDEST) {
+                break;
+            }
+            numOldest++;
+        }
+        if (numOldest == 0) {
+            break;
+        }
+        // Only take what is needed to get back under high water.
+        size_t highWater = lane.events.capacity() * 3 / 4;
+        numOldest = std::min(numOldest, lane.events.size() - highWater + 1);
+        lane.events.consume(numOldest);
+        numEvicted += numOldest;
+    }
+    counters.numEvicted += numEvicted;
+    lane.numDropped += numEvicted;
+    return numEvicted;
+}
+
+size_t HalProxyState::takeSpill(PendingWriteLane& lane, Event* out, size_t maxCount) {
+    if (lane.spillSize == 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(lane.spillMutex);
+    size_t count = std::min(maxCount, lane.spillSize.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < count; i++) {
+        out[i] = lane.spill[(lane.spillHead + i) % lane.spillCapacity];
+    }
+    lane.spillHead = (lane.spillHead + count) % lane.spillCapacity;
+    lane.spillSize -= count;
+    return count;
+}
+
+void HalProxyState::clearPendingWrites() {
+    for (PendingWriteLane& lane : pendingWrites) {
+        lane.events.clear();
+        std::lock_guard<std::mutex> lock(lane.spillMutex);
+        lane.spillHead = 0;
+        lane.spillSize = 0;
+    }
+}
+
+HalProxyState& getHalProxyState() {
+    static HalProxyState state;
+    return state;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
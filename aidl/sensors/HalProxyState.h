@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "ActivationCache.h"
+#include "AlsScreen.h"
+#include "Clock.h"
+#include "ConsumerSignal.h"
+#include "DirectChannelRouter.h"
+#include "EventQueueWriter.h"
+#include "EventRing.h"
+#include "OverflowPolicy.h"
+#include "SensorRegistry.h"
+#include "SensorRules.h"
+#include "SensorTrace.h"
+#include "SharedWakelock.h"
+#include "SubHalWatchdog.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Backlog of events waiting for space in the event FMQ. Wake up events share a lane so that a
+ * burst of continuous samples can never delay them, non-wake up events get a lane per sub-HAL so
+ * that a sub-HAL flooding its lane cannot crowd out the others.
+ */
+struct PendingWriteLane {
+    PendingWriteLane(std::string name, size_t capacity, size_t spillCapacity)
+        : name(std::move(name)),
+          events(capacity),
+          spillCapacity(spillCapacity),
+          spill(std::make_unique<Event[]>(spillCapacity)) {}
+
+    const std::string name;
+    EventRing<Event> events;
+
+    // NEVER_DROP events that did not fit into the ring. While it is not empty, all NEVER_DROP
+    // events of the lane go here so that they stay in order; it is drained after the ring. It is
+    // allocated upfront, once it is full NEVER_DROP events are dropped like DROP_NEWEST ones.
+    const size_t spillCapacity;
+    std::mutex spillMutex;
+    // Circular, guarded by spillMutex. spillSize is only written with it held.
+    std::unique_ptr<Event[]> spill;
+    size_t spillHead = 0;
+    std::atomic<size_t> spillSize = 0;
+
+    std::atomic<uint64_t> numDropped = 0;
+    std::atomic<size_t> mostPending = 0;
+    // Time events spent in the ring before being written to the FMQ.
+    Log2Histogram backlogTimeUs;
+
+    // Above half full, DECIMATE sensors start to shed samples.
+    bool isUnderPressure() const { return events.size() * 2 >= events.capacity(); }
+    // Above three quarters full, DROP_OLDEST sensors lose their oldest queued samples.
+    bool isAboveHighWater() const { return events.size() * 4 >= events.capacity() * 3; }
+};
+
+/**
+ * Limits how often the framework reader of the event FMQ is woken up.
+ *
+ * Each wake is a futex wake into system_server, so a high rate sensor that gets every batch
+ * written on its own costs a wake per sample. With a window set, events written less than a window
+ * after the previous wake are left in the FMQ and the pending writes thread wakes the reader once
+ * the window is over. Sensors posting slower than the window, and urgent events, still wake the
+ * reader right away. All calls are made with the event FMQ write lock held.
+ */
+class ReaderWakeCoalescer {
+  public:
+    void setWindowNs(int64_t windowNs) { mWindowNs = windowNs; }
+    int64_t getWindowNs() const { return mWindowNs; }
+    bool isEnabled() const { return mWindowNs > 0; }
+
+    /**
+     * Called after writing events to the FMQ.
+     *
+     * @param urgent Whether the events, or a full FMQ, must reach the reader without delay.
+     *
+     * @return Whether to wake the reader now. Otherwise the wake is deferred.
+     */
+    bool shouldWakeNow(bool urgent);
+
+    void onWake();
+
+    bool hasDeferredWake() const { return mWakeDeferred.load(); }
+
+    /**
+     * @return Nanoseconds until the deferred wake is due, 0 if it is due and -1 if there is none.
+     */
+    int64_t getDeferredWakeDelayNs() const;
+
+    std::atomic<uint64_t> numWakes = 0;
+    std::atomic<uint64_t> numDeferred = 0;
+
+  private:
+    int64_t mWindowNs = 0;
+    std::atomic<int64_t> mLastWakeNs = 0;
+    std::atomic_bool mWakeDeferred = false;
+};
+
+struct SubHalStartupTiming {
+    int64_t loadNs = 0;
+    int64_t initializeNs = 0;
+};
+
+enum PendingWriteLaneIndex : size_t {
+    // Drained first.
+    kWakeupLane = 0,
+    // Followed by the non-wake up lane of each sub-HAL, drained round-robin.
+    kFirstSubHalLane,
+};
+
+/**
+ * State of the HalProxy event pipeline that is not part of the HalProxy class.
+ *
+ * The HalProxy class layout comes from the upstream multihal header, which the prebuilt
+ * HalProxyAidl is compiled against, so members added by this implementation live here instead.
+ * There is only ever one HalProxy per process.
+ */
+struct HalProxyState {
+    HalProxyState();
+
+    // Events posted while the FMQ was full or busy, drained by the pending writes thread. Indexed
+    // by PendingWriteLaneIndex.
+    std::deque<PendingWriteLane> pendingWrites;
+    // Sub-HAL lane the pending writes thread serves first on its next pass.
+    size_t nextSubHalLane = 0;
+    ConsumerSignal pendingWritesSignal;
+    SubHalWatchdog watchdog;
+    ReaderWakeCoalescer readerWake;
+    // Writes to the event FMQ, directly or through pendingWrites.
+    EventQueueWriter eventQueueWriter;
+
+    SensorRegistry sensorRegistry;
+    SensorRules sensorRules;
+    OverflowPolicies overflowPolicies;
+    ActivationCache activationCache;
+    // Shared by the ALS corrections of all light sensors, created with the first one.
+    std::shared_ptr<AlsScreen> alsScreen;
+
+    // Batches and events posted by sub-HALs, and how many batches had to grow one of the staging
+    // buffers the callbacks reuse. Only those growths are counted, not every allocation on the
+    // event path, see the pipeline benchmark for allocations per event.
+    std::atomic<uint64_t> numEventBatches = 0;
+    std::atomic<uint64_t> numEventsPosted = 0;
+    std::atomic<uint64_t> numStagingBufferGrowths = 0;
+    // Batches that callbacks put directly into the backlog because the FMQ was backed up.
+    std::atomic<uint64_t> numBatchesWrittenToBacklog = 0;
+    // Events the pending writes thread took from the backlog and wrote to the FMQ.
+    std::atomic<uint64_t> numEventsWrittenFromBacklog = 0;
+
+    // Replaces the wakelock accounting of the HalProxy class.
+    SharedWakelock sharedWakelock;
+
+    // Records what the sub-HALs post, see vendor.sensors.trace_file.
+    TraceRecorder traceRecorder;
+
+    DirectChannelRouter directChannelRouter;
+
+    // Load and initialize sub-HALs concurrently.
+    bool parallelSubHalStartup = false;
+
+    // Startup timings.
+    int64_t loadSubHalsNs = 0;
+    int64_t initializeSensorListNs = 0;
+    // Indexed by sub-HAL index.
+    std::vector<SubHalStartupTiming> subHalTimings;
+
+    /**
+     * Create the per sub-HAL state. Only grows, must not be called once events flow.
+     */
+    void setNumSubHals(size_t numSubHals);
+
+    size_t getNumSubHalLanes() const { return pendingWrites.size() - kFirstSubHalLane; }
+
+    /**
+     * @return The index of the lane that holds the non-wake up events of a sub-HAL.
+     */
+    size_t getSubHalLaneIndex(size_t subHalIndex) const {
+        return kFirstSubHalLane + std::min(subHalIndex, getNumSubHalLanes() - 1);
+    }
+
+    bool hasPendingWrites() const;
+
+    /**
+     * Pending writes thread: whether the next pass can make progress, as opposed to only finding
+     * slots that producers reserved but did not commit yet. Follows the order the lanes are
+     * drained in, so a wake up lane waiting on a producer holds back the sub-HAL lanes too.
+     */
+    bool hasCommittedPendingWrites() const;
+
+    /**
+     * @return Whether any of the events comes from a wake up or one-shot sensor.
+     */
+    bool hasUrgentEvents(const Event* events, size_t count);
+
+    /**
+     * @return Whether new events may bypass the overflow policies, because no lane is under
+     *         pressure or spilling.
+     */
+    bool isBacklogRelaxed() const;
+
+    /**
+     * Record the latency of events that were just written to the FMQ.
+     *
+     * @param lane The lane the events were taken from, if they come from its ring.
+     */
+    void onEventsWritten(PendingWriteLane* lane, const Event* events, size_t count);
+
+    /**
+     * Account for events that were just added to a lane and wake the pending writes thread.
+     */
+    void onPendingWritesQueued(PendingWriteLane& lane);
+
+    /**
+     * Add events to a lane, applying the overflow policy of their sensors when it is under
+     * pressure or full.
+     *
+     * @return The number of events that were not queued.
+     */
+    size_t queuePendingWrites(size_t laneIndex, const Event* events, size_t count);
+
+    /**
+     * Pending writes thread: discard the oldest DROP_OLDEST events of a lane above high water.
+     *
+     * @return The number of events discarded.
+     */
+    size_t evictOldest(PendingWriteLane& lane);
+
+    /**
+     * Pending writes thread: move up to maxCount spilled events of a lane to out.
+     */
+    size_t takeSpill(PendingWriteLane& lane, Event* out, size_t maxCount);
+
+    /**
+     * Drop everything queued or spilled in every lane. Only safe while no events flow.
+     */
+    void clearPendingWrites();
+};
+
+HalProxyState& getHalProxyState();
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Fixed bucket histogram that any number of threads can record into without locking. Bucket i
+ * counts values below 2^i that do not fit a lower bucket; the last bucket has no upper bound.
+ */
+class Log2Histogram {
+  public:
+    static constexpr size_t kNumBuckets = 24;
+
+    void record(uint64_t value, uint64_t count = 1) {
+        size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        if (bucket >= kNumBuckets) bucket = kNumBuckets - 1;
+        mBuckets[bucket].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * Add the counts of another histogram to this one.
+     */
+    void merge(const Log2Histogram& other) {
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            mBuckets[i].fetch_add(other.getCount(i), std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t getCount(size_t bucket) const {
+        return mBuckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    uint64_t getTotal() const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            total += getCount(i);
+        }
+        return total;
+    }
+
+    /**
+     * @return The upper bound of the bucket holding the given fraction of the recorded values,
+     *         or 0 if nothing was recorded.
+     */
+    uint64_t getPercentile(double fraction) const {
+        uint64_t total = getTotal();
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            seen += getCount(i);
+            if (total > 0 && seen >= total * fraction) {
+                return UINT64_C(1) << i;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Print the non-empty buckets as " <bound: count".
+     */
+    void dumpText(std::ostream& stream) const {
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            uint64_t count = getCount(i);
+            if (count == 0) continue;
+            stream << " <";
+            if (i < kNumBuckets - 1) {
+                stream << (UINT64_C(1) << i);
+            } else {
+                stream << "inf";
+            }
+            stream << ": " << count;
+        }
+    }
+
+    /**
+     * Print all buckets as a JSON array of counts.
+     */
+    void dumpJson(std::ostream& stream) const {
+        stream << "[";
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            stream << (i > 0 ? "," : "") << getCount(i);
+        }
+        stream << "]";
+    }
+
+  private:
+    std::atomic<uint64_t> mBuckets[kNumBuckets] = {};
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "OverflowPolicy.h"
+
+#include <log/log.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+
+static constexpr uint32_t kDefaultDecimation = 2;
+// Continuous sensors that can go this fast decimate by default.
+static constexpr int32_t kHighRateMinDelayUs = 5000;
+
+const char* toString(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::DROP_NEWEST:
+            return "drop_newest";
+        case OverflowPolicy::DROP_OLDEST:
+            return "drop_oldest";
+        case OverflowPolicy::NEVER_DROP:
+            return "never_drop";
+        case OverflowPolicy::DECIMATE:
+            return "decimate";
+        default:
+            return "unknown";
+    }
+}
+
+static bool parsePolicy(const std::string& name, OverflowPolicy* policy) {
+    for (size_t i = 0; i < static_cast<size_t>(OverflowPolicy::COUNT); i++) {
+        if (name == toString(static_cast<OverflowPolicy>(i))) {
+            *policy = static_cast<OverflowPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void OverflowPolicies::loadConfigFile(const char* configFileName) {
+    std::ifstream configStream(configFileName);
+    if (!configStream) {
+        return;
+    }
+
+    std::string line;
+    while (std::getline(configStream, line)) {
+        std::istringstream is(line);
+        std::string sensor, policyName;
+        if (!(is >> sensor) || sensor[0] == '#') {
+            continue;
+        }
+
+        ConfigEntry entry = {OverflowPolicy::DROP_NEWEST, 1};
+        if (!(is >> policyName) || !parsePolicy(policyName, &entry.policy)) {
+            ALOGE("Invalid overflow policy for %s in %s", sensor.c_str(), configFileName);
+            continue;
+        }
+        if (entry.policy == OverflowPolicy::DECIMATE && !(is >> entry.decimation)) {
+            entry.decimation = kDefaultDecimation;
+        }
+        mConfig[sensor] = entry;
+    }
+}
+
+void OverflowPolicies::configure(const SensorInfo& sensor, SensorOverflowState* state) {
+    auto config = mConfig.find(sensor.typeAsString);
+    if (config == mConfig.end()) {
+        config = mConfig.find(sensor.name);
+    }
+    uint32_t reportingMode = sensor.flags & SensorFlagBits::MASK_REPORTING_MODE;
+    if (config != mConfig.end()) {
+        state->policy = config->second.policy;
+        state->decimation = config->second.decimation;
+    } else if ((sensor.flags & SensorFlagBits::WAKE_UP) ||
+               reportingMode == static_cast<uint32_t>(SensorFlagBits::ONE_SHOT_MODE)) {
+        state->policy = OverflowPolicy::NEVER_DROP;
+    } else if (reportingMode == static_cast<uint32_t>(SensorFlagBits::CONTINUOUS_MODE) &&
+               sensor.minDelay > 0 && sensor.minDelay <= kHighRateMinDelayUs) {
+        state->policy = OverflowPolicy::DECIMATE;
+        state->decimation = kDefaultDecimation;
+    } else if (reportingMode == static_cast<uint32_t>(SensorFlagBits::CONTINUOUS_MODE)) {
+        state->policy = OverflowPolicy::DROP_OLDEST;
+    } else {
+        state->policy = OverflowPolicy::DROP_NEWEST;
+    }
+    getCounters(state->policy).numSensors++;
+}
+
+void OverflowPolicies::dump(std::ostream& stream) {
+    stream << "  Overflow policies:" << std::endl;
+    for (size_t i = 0; i < static_cast<size_t>(OverflowPolicy::COUNT); i++) {
+        const OverflowPolicyCounters& counters = mCounters[i];
+        stream << "    " << toString(static_cast<OverflowPolicy>(i)) << ": " << counters.numSensors
+               << " sensors, dropped " << counters.numDropped << ", evicted "
+               << counters.numEvicted << ", decimated " << counters.numDecimated << ", spilled "
+               << counters.numSpilled << std::endl;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <atomic>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * What to do with a sensor's events when the pending writes backlog cannot keep up.
+ */
+enum class OverflowPolicy : uint8_t {
+    // Drop whatever does not fit anymore. This is what happens to sensors nobody cares about.
+    DROP_NEWEST = 0,
+    // Discard the oldest queued samples once the backlog runs high, newer samples are worth more.
+    DROP_OLDEST,
+    // Keep every event, spilling to a bounded queue when the backlog is full. Only once that is
+    // full too are events dropped, like with DROP_NEWEST.
+    NEVER_DROP,
+    // Keep only every Nth sample while the backlog is under pressure.
+    DECIMATE,
+    COUNT,
+};
+
+const char* toString(OverflowPolicy policy);
+
+struct SensorOverflowState {
+    OverflowPolicy policy = OverflowPolicy::DROP_NEWEST;
+    uint32_t decimation = 1;
+    std::atomic<uint32_t> numSeenUnderPressure = 0;
+
+    /**
+     * @return Whether a sample arriving under pressure survives decimation.
+     */
+    bool keepUnderPressure() {
+        return decimation <= 1 || numSeenUnderPressure.fetch_add(1) % decimation == 0;
+    }
+};
+
+struct OverflowPolicyCounters {
+    // Sensors using the policy.
+    std::atomic<size_t> numSensors = 0;
+    // Events that did not fit and were thrown away.
+    std::atomic<uint64_t> numDropped = 0;
+    // Queued events discarded to make room for newer ones.
+    std::atomic<uint64_t> numEvicted = 0;
+    // Events skipped by decimation.
+    std::atomic<uint64_t> numDecimated = 0;
+    // Events that overflowed into the spill queue.
+    std::atomic<uint64_t> numSpilled = 0;
+};
+
+/**
+ * Per sensor overflow policies.
+ *
+ * Defaults follow the reporting mode: one-shot and wake up sensors never drop, continuous sensors
+ * that can run at 200 Hz or more decimate, other continuous sensors drop their oldest samples and
+ * everything else drops the newest ones. A config file next to
+ * hals.conf can override this per sensor, one "<type string or name> <policy> [factor]" per line.
+ */
+class OverflowPolicies {
+  public:
+    void loadConfigFile(const char* configFileName);
+
+    /**
+     * Pick the policy of a sensor from the static sensor list. Sensors that are not configured,
+     * like dynamic sensors, are treated as DROP_NEWEST.
+     */
+    void configure(const SensorInfo& sensor, SensorOverflowState* state);
+
+    OverflowPolicyCounters& getCounters(OverflowPolicy policy) {
+        return mCounters[static_cast<size_t>(policy)];
+    }
+
+    void dump(std::ostream& stream);
+
+  private:
+    struct ConfigEntry {
+        OverflowPolicy policy;
+        uint32_t decimation;
+    };
+
+    std::map<std::string, ConfigEntry> mConfig;
+    OverflowPolicyCounters mCounters[static_cast<size_t>(OverflowPolicy::COUNT)];
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorRegistry.h"
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+
+SensorEntry& SensorRegistry::addSensor(const SensorInfo& sensor) {
+    SensorEntry& entry = mEntries.emplace_back();
+    entry.sensorHandle = sensor.sensorHandle;
+    entry.name = sensor.name;
+    entry.isWakeup = (sensor.flags & SensorFlagBits::WAKE_UP) != 0;
+    entry.isOneShot = (sensor.flags & SensorFlagBits::MASK_REPORTING_MODE) ==
+                      static_cast<uint32_t>(SensorFlagBits::ONE_SHOT_MODE);
+
+    size_t subHalIndex = static_cast<uint32_t>(sensor.sensorHandle) >> kBitsAfterSubHalIndex;
+    int32_t localHandle = sensor.sensorHandle & kLocalHandleMask;
+    if (localHandle <= kMaxDenseHandle) {
+        if (mDense.size() <= subHalIndex) {
+            mDense.resize(subHalIndex + 1);
+        }
+        std::vector<SensorEntry*>& table = mDense[subHalIndex];
+        if (table.size() <= static_cast<size_t>(localHandle)) {
+            table.resize(localHandle + 1, nullptr);
+        }
+        table[localHandle] = &entry;
+    } else {
+        mSparse[sensor.sensorHandle] = &entry;
+    }
+    return entry;
+}
+
+SensorEntry* SensorRegistry::findSparse(size_t subHalIndex, int32_t localHandle) {
+    if (mSparse.empty()) {
+        return nullptr;
+    }
+    auto entry = mSparse.find(
+            localHandle | static_cast<int32_t>(subHalIndex << kBitsAfterSubHalIndex));
+    return entry != mSparse.end() ? entry->second : nullptr;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
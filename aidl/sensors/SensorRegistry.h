@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "AlsCorrection.h"
+#include "Histogram.h"
+#include "OverflowPolicy.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Per event work for a sensor, compiled from the sensor rules.
+ */
+struct SensorEventActions {
+    // Only forward events whose scalar value equals filterValue.
+    bool hasValueFilter = false;
+    float filterValue = 0;
+    // Mirror the scalar value as a boolean to this node, if open.
+    int nodeFd = -1;
+    bool nodeInverted = false;
+    bool needsAlsCorrection = false;
+    // Default properties if empty.
+    std::string alsCorrectionPropertyPrefix;
+};
+
+/**
+ * Everything the event path needs to know about a sensor, precomputed when the sensor list is
+ * built so that no SensorInfo or string has to be looked at per event.
+ */
+struct SensorEntry {
+    int32_t sensorHandle = 0;
+    // Only used for dumps.
+    std::string name;
+    bool isWakeup = false;
+    bool isOneShot = false;
+
+    SensorEventActions actions;
+    SensorOverflowState overflow;
+    // Set if the actions need the ambient light correction.
+    std::unique_ptr<AlsCorrection> alsCorrection;
+
+    // Time from the event timestamp to the event being written to the FMQ.
+    Log2Histogram eventLatencyUs;
+};
+
+/**
+ * Static sensors of all sub-HALs, indexed by sub-HAL index and sub-HAL local handle.
+ *
+ * Built once in HalProxy::initializeSensorList() and read concurrently by the sub-HAL callback
+ * threads afterwards, so it must not be modified once events flow.
+ */
+class SensorRegistry {
+  public:
+    static constexpr int32_t kBitsAfterSubHalIndex = 24;
+    static constexpr int32_t kLocalHandleMask = (1 << kBitsAfterSubHalIndex) - 1;
+
+    /**
+     * @param sensor Sensor with the sub-HAL index already set in its handle.
+     */
+    SensorEntry& addSensor(const SensorInfo& sensor);
+
+    SensorEntry* find(size_t subHalIndex, int32_t localHandle) {
+        if (subHalIndex < mDense.size() && localHandle >= 0 &&
+            static_cast<size_t>(localHandle) < mDense[subHalIndex].size()) {
+            return mDense[subHalIndex][localHandle];
+        }
+        return findSparse(subHalIndex, localHandle);
+    }
+
+    SensorEntry* find(int32_t sensorHandle) {
+        return find(static_cast<uint32_t>(sensorHandle) >> kBitsAfterSubHalIndex,
+                    sensorHandle & kLocalHandleMask);
+    }
+
+    template <typename Function>
+    void forEach(Function function) {
+        for (SensorEntry& entry : mEntries) {
+            function(entry);
+        }
+    }
+
+    size_t size() const { return mEntries.size(); }
+
+  private:
+    // Local handles up to this are indexed directly, larger ones go through a hash map.
+    static constexpr int32_t kMaxDenseHandle = 1024;
+
+    SensorEntry* findSparse(size_t subHalIndex, int32_t localHandle);
+
+    std::deque<SensorEntry> mEntries;
+    std::vector<std::vector<SensorEntry*>> mDense;
+    std::unordered_map<int32_t, SensorEntry*> mSparse;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorRules.h"
+
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+
+static constexpr char kTypePrefix[] = "type:";
+
+static constexpr char kDefaultRules[] = R"(
+# Motion detector, exposed as the glance gesture.
+qti.sensor.amd wakeup_only
+qti.sensor.amd remap_type 24 android.sensor.glance_gesture 2
+android.sensor.glance_gesture drop_unless_value 2
+
+# Tilt detector, exposed as the pick up gesture.
+android.sensor.tilt_detector wakeup_only
+android.sensor.tilt_detector remap_type 25 android.sensor.pick_up_gesture 1
+android.sensor.pick_up_gesture drop_unless_value 0
+
+# The panel needs to know whether it is dark while in AOD.
+qti.sensor.lux_aod write_node /sys/kernel/oplus_display/aod_light_mode_set inverted
+
+# QTI wise light, exposed as the corrected light sensor.
+type:33171103 als_correction
+type:33171103 remap_type 5 android.sensor.light
+)";
+
+static bool parseAction(const std::string& name, SensorRuleAction* action) {
+    static const std::map<std::string, SensorRuleAction> kActions = {
+            {"wakeup_only", SensorRuleAction::WAKEUP_ONLY},
+            {"hide", SensorRuleAction::HIDE},
+            {"remap_type", SensorRuleAction::REMAP_TYPE},
+            {"drop_unless_value", SensorRuleAction::DROP_UNLESS_VALUE},
+            {"write_node", SensorRuleAction::WRITE_NODE},
+            {"als_correction", SensorRuleAction::ALS_CORRECTION},
+    };
+    auto it = kActions.find(name);
+    if (it == kActions.end()) {
+        return false;
+    }
+    *action = it->second;
+    return true;
+}
+
+SensorRules::~SensorRules() {
+    for (const auto& [path, fd] : mNodeFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void SensorRules::loadConfigFile(const char* configFileName) {
+    std::ifstream configStream(configFileName);
+    if (!configStream) {
+        return;
+    }
+    load(configStream, configFileName);
+}
+
+void SensorRules::loadDefaultsIfNeeded() {
+    if (!mSource.empty()) {
+        return;
+    }
+    std::istringstream defaultsStream(kDefaultRules);
+    load(defaultsStream, "built-in");
+}
+
+void SensorRules::load(std::istream& stream, const char* source) {
+    mSource = mSource.empty() ? source : mSource + ", " + source;
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream is(line);
+        std::string actionName;
+        SensorRule rule;
+        if (!(is >> rule.match) || rule.match[0] == '#') {
+            continue;
+        }
+        if (!(is >> actionName) || !parseAction(actionName, &rule.action)) {
+            ALOGE("Invalid sensor rule action for %s in %s", rule.match.c_str(), source);
+            continue;
+        }
+
+        bool valid = true;
+        switch (rule.action) {
+            case SensorRuleAction::REMAP_TYPE:
+                valid = static_cast<bool>(is >> rule.type >> rule.typeAsString);
+                rule.hasMaxRange = static_cast<bool>(is >> rule.value);
+                break;
+            case SensorRuleAction::DROP_UNLESS_VALUE:
+                valid = static_cast<bool>(is >> rule.value);
+                break;
+            case SensorRuleAction::WRITE_NODE: {
+                std::string modifier;
+                valid = static_cast<bool>(is >> rule.path);
+                rule.inverted = (is >> modifier) && modifier == "inverted";
+                break;
+            }
+            case SensorRuleAction::ALS_CORRECTION:
+                is >> rule.propertyPrefix;
+                break;
+            default:
+                break;
+        }
+        if (!valid) {
+            ALOGE("Missing arguments for %s %s in %s", rule.match.c_str(), actionName.c_str(),
+                  source);
+            continue;
+        }
+        mRules.push_back(std::move(rule));
+    }
+}
+
+bool SensorRules::matches(const SensorRule& rule, const SensorInfo& sensor) const {
+    if (rule.match.compare(0, sizeof(kTypePrefix) - 1, kTypePrefix) == 0) {
+        return rule.match.substr(sizeof(kTypePrefix) - 1) ==
+               std::to_string(static_cast<int32_t>(sensor.type));
+    }
+    return rule.match == sensor.typeAsString || rule.match == sensor.name;
+}
+
+int SensorRules::openNode(const std::string& path) {
+    auto it = mNodeFds.find(path);
+    if (it == mNodeFds.end()) {
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ALOGE("Failed to open %s", path.c_str());
+        }
+        it = mNodeFds.emplace(path, fd).first;
+    }
+    return it->second;
+}
+
+bool SensorRules::apply(SensorInfo& sensor, SensorEventActions* actions) {
+    for (const SensorRule& rule : mRules) {
+        if (!matches(rule, sensor)) {
+            continue;
+        }
+        switch (rule.action) {
+            case SensorRuleAction::WAKEUP_ONLY:
+                if (!(sensor.flags & SensorFlagBits::WAKE_UP)) {
+                    mNumHidden++;
+                    return false;
+                }
+                break;
+            case SensorRuleAction::HIDE:
+                mNumHidden++;
+                return false;
+            case SensorRuleAction::REMAP_TYPE:
+                sensor.type = static_cast<SensorType>(rule.type);
+                sensor.typeAsString = rule.typeAsString;
+                if (rule.hasMaxRange) {
+                    sensor.maxRange = rule.value;
+                }
+                break;
+            case SensorRuleAction::DROP_UNLESS_VALUE:
+                actions->hasValueFilter = true;
+                actions->filterValue = rule.value;
+                break;
+            case SensorRuleAction::WRITE_NODE:
+                actions->nodeFd = openNode(rule.path);
+                actions->nodeInverted = rule.inverted;
+                break;
+            case SensorRuleAction::ALS_CORRECTION:
+                actions->needsAlsCorrection = true;
+                actions->alsCorrectionPropertyPrefix = rule.propertyPrefix;
+                break;
+        }
+    }
+    return true;
+}
+
+void SensorRules::dump(std::ostream& stream) {
+    stream << "  Sensor rules: " << mRules.size() << " from " << mSource << ", " << mNumHidden
+           << " sensors hidden" << std::endl;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
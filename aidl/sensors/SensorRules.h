@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "SensorRegistry.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+enum class SensorRuleAction : uint8_t {
+    // Hide the non-wake up variant of the sensor.
+    WAKEUP_ONLY,
+    // Hide the sensor altogether.
+    HIDE,
+    // Report the sensor as a different type: <type> <type string> [max range].
+    REMAP_TYPE,
+    // Only forward events whose scalar value equals <value>.
+    DROP_UNLESS_VALUE,
+    // Mirror the scalar value as a boolean to <path>, optionally "inverted".
+    WRITE_NODE,
+    // Run events through the ambient light correction, configured by the properties under
+    // [property prefix].
+    ALS_CORRECTION,
+};
+
+struct SensorRule {
+    // Type string, name or "type:<numeric type>" of the sensor.
+    std::string match;
+    SensorRuleAction action;
+
+    int32_t type = 0;
+    std::string typeAsString;
+    bool hasMaxRange = false;
+    float value = 0;
+    std::string path;
+    bool inverted = false;
+    std::string propertyPrefix;
+};
+
+/**
+ * Per sensor quirks, one "<match> <action> [arguments]" per line.
+ *
+ * Rules are applied in order while the sensor list is built, each one seeing the sensor as left
+ * by the previous ones, and compiled into the SensorEventActions of the sensor so the event path
+ * never looks at them again. A config file next to hals.conf replaces the built-in rules.
+ */
+class SensorRules {
+  public:
+    ~SensorRules();
+
+    void loadConfigFile(const char* configFileName);
+
+    /**
+     * Fall back to the built-in rules if no config file was found.
+     */
+    void loadDefaultsIfNeeded();
+
+    /**
+     * Rewrite a sensor from a sub-HAL sensor list and compile its event actions.
+     *
+     * @return false if the sensor must not be exposed.
+     */
+    bool apply(SensorInfo& sensor, SensorEventActions* actions);
+
+    void dump(std::ostream& stream);
+
+  private:
+    void load(std::istream& stream, const char* source);
+    bool matches(const SensorRule& rule, const SensorInfo& sensor) const;
+    int openNode(const std::string& path);
+
+    std::vector<SensorRule> mRules;
+    std::string mSource;
+    // Nodes stay open so that events only pay for the write.
+    std::map<std::string, int> mNodeFds;
+    size_t mNumHidden = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
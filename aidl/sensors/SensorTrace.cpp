@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorTrace.h"
+
+#include "Clock.h"
+
+#include <log/log.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+TraceRecorder::~TraceRecorder() {
+    stop();
+}
+
+bool TraceRecorder::start(const std::string& path, const std::map<int32_t, SensorInfo>& sensors) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFile != nullptr) {
+        return true;
+    }
+
+    mFile = fopen(path.c_str(), "we");
+    if (mFile == nullptr) {
+        ALOGE("Failed to open sensor trace %s: %d", path.c_str(), errno);
+        return false;
+    }
+    mPath = path;
+
+    TraceFileHeader header = {};
+    memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+    header.eventSize = sizeof(Event);
+    header.startBoottimeNs = getClockNs(CLOCK_BOOTTIME);
+    header.startRealtimeNs = getClockNs(CLOCK_REALTIME);
+    fwrite(&header, sizeof(header), 1, mFile);
+
+    for (const auto& [sensorHandle, sensor] : sensors) {
+        TraceSensor record = {
+                .sensorHandle = sensor.sensorHandle,
+                .type = static_cast<int32_t>(sensor.type),
+                .flags = sensor.flags,
+                .minDelay = sensor.minDelay,
+                .maxDelay = sensor.maxDelay,
+                .fifoReservedEventCount = sensor.fifoReservedEventCount,
+                .fifoMaxEventCount = sensor.fifoMaxEventCount,
+                .maxRange = sensor.maxRange,
+                .resolution = sensor.resolution,
+                .power = sensor.power,
+                .nameLength = static_cast<uint16_t>(sensor.name.size()),
+                .typeAsStringLength = static_cast<uint16_t>(sensor.typeAsString.size()),
+        };
+        std::string strings = std::string(sensor.name) + std::string(sensor.typeAsString);
+        writeRecord(kTraceSensor, &record, sizeof(record), strings.data(), strings.size());
+    }
+
+    if (mFile == nullptr) {
+        return false;
+    }
+    mNumBatches = 0;
+    mNumEvents = 0;
+    mRecording = true;
+    ALOGI("Recording sensor trace to %s", path.c_str());
+    return true;
+}
+
+void TraceRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecording = false;
+    if (mFile != nullptr) {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+void TraceRecorder::recordBatch(size_t subHalIndex, const std::vector<Event>& events,
+                                bool wakelockLocked, size_t wakelockRefCount) {
+    TraceBatch record = {
+            .arrivalNs = getClockNs(CLOCK_BOOTTIME),
+            .wakelockRefCount = static_cast<uint32_t>(wakelockRefCount),
+            .numEvents = static_cast<uint32_t>(events.size()),
+            .subHalIndex = static_cast<uint8_t>(subHalIndex),
+            .flags = static_cast<uint8_t>(wakelockLocked ? kTraceWakelockLocked : 0),
+            .reserved = 0,
+    };
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFile == nullptr) {
+        return;
+    }
+    writeRecord(kTraceBatch, &record, sizeof(record), events.data(),
+                events.size() * sizeof(Event));
+    mNumBatches++;
+    mNumEvents += events.size();
+}
+
+void TraceRecorder::dump(std::ostream& stream) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFile == nullptr) {
+        return;
+    }
+    fflush(mFile);
+    stream << "  Recording sensor trace to " << mPath << ": " << mNumBatches << " batches, "
+           << mNumEvents << " events" << std::endl;
+}
+
+void TraceRecorder::writeRecord(TraceRecordType type, const void* data, size_t size,
+                                const void* extra, size_t extraSize) {
+    if (mFile == nullptr) {
+        return;
+    }
+    TraceRecordHeader header = {
+            .type = type,
+            .size = static_cast<uint32_t>(size + extraSize),
+    };
+    if (fwrite(&header, sizeof(header), 1, mFile) != 1 || fwrite(data, size, 1, mFile) != 1 ||
+        (extraSize > 0 && fwrite(extra, extraSize, 1, mFile) != 1)) {
+        ALOGE("Failed to write sensor trace, stopping: %d", errno);
+        fclose(mFile);
+        mFile = nullptr;
+        mRecording = false;
+    }
+}
+
+bool Trace::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "re");
+    if (file == nullptr) {
+        ALOGE("Failed to open sensor trace %s: %d", path.c_str(), errno);
+        return false;
+    }
+
+    // The path comes from a property, so never trust a size read from the file to allocate.
+    long fileSize = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        fileSize = ftell(file);
+        rewind(file);
+    }
+
+    bool valid = fileSize >= 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, kTraceMagic, sizeof(header.magic)) == 0 &&
+                 header.version == kTraceVersion && header.eventSize == sizeof(Event);
+    TraceRecordHeader record;
+    std::vector<char> payload;
+    while (valid && fread(&record, sizeof(record), 1, file) == 1) {
+        long remaining = fileSize - ftell(file);
+        if (remaining < 0 || record.size > static_cast<unsigned long>(remaining)) {
+            // Recording was cut short, keep what is complete.
+            break;
+        }
+        payload.resize(record.size);
+        if (record.size > 0 && fread(payload.data(), record.size, 1, file) != 1) {
+            break;
+        }
+
+        if ((record.type == kTraceSensor && record.size < sizeof(TraceSensor)) ||
+            (record.type == kTraceBatch && record.size < sizeof(TraceBatch))) {
+            valid = false;
+            break;
+        }
+        if (record.type == kTraceSensor) {
+            TraceSensor traceSensor;
+            memcpy(&traceSensor, payload.data(), sizeof(traceSensor));
+            if (sizeof(traceSensor) + traceSensor.nameLength + traceSensor.typeAsStringLength >
+                record.size) {
+                valid = false;
+                break;
+            }
+            const char* strings = payload.data() + sizeof(traceSensor);
+            SensorInfo sensor;
+            sensor.sensorHandle = traceSensor.sensorHandle;
+            sensor.type = static_cast<SensorType>(traceSensor.type);
+            sensor.flags = traceSensor.flags;
+            sensor.minDelay = traceSensor.minDelay;
+            sensor.maxDelay = traceSensor.maxDelay;
+            sensor.fifoReservedEventCount = traceSensor.fifoReservedEventCount;
+            sensor.fifoMaxEventCount = traceSensor.fifoMaxEventCount;
+            sensor.maxRange = traceSensor.maxRange;
+            sensor.resolution = traceSensor.resolution;
+            sensor.power = traceSensor.power;
+            sensor.name = std::string(strings, traceSensor.nameLength);
+            sensor.typeAsString = std::string(strings + traceSensor.nameLength,
+                                              traceSensor.typeAsStringLength);
+            sensors.push_back(sensor);
+        } else if (record.type == kTraceBatch) {
+            Batch batch;
+            memcpy(&batch.header, payload.data(), sizeof(batch.header));
+            size_t eventsSize = record.size - sizeof(batch.header);
+            if (eventsSize % sizeof(Event) != 0 ||
+                batch.header.numEvents != eventsSize / sizeof(Event)) {
+                valid = false;
+                break;
+            }
+            batch.events.resize(batch.header.numEvents);
+            memcpy(batch.events.data(), payload.data() + sizeof(batch.header),
+                   batch.header.numEvents * sizeof(Event));
+            batches.push_back(std::move(batch));
+        }
+        // Unknown records are skipped, so that older tools can read newer traces.
+    }
+
+    fclose(file);
+    if (!valid) {
+        ALOGE("Sensor trace %s is invalid", path.c_str());
+    }
+    return valid;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Binary trace of the events sub-HALs post to HalProxy. Little endian, native struct layout, so a
+ * trace is only meant to be replayed on the same architecture.
+ *
+ * The file starts with a TraceFileHeader, followed by records that each start with a
+ * TraceRecordHeader. The sensor list comes first, one kTraceSensor record per sensor, then one
+ * kTraceBatch record per postEvents() call.
+ */
+constexpr char kTraceMagic[8] = {'S', 'N', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t kTraceVersion = 1;
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t eventSize;
+    // Clocks when recording started, to turn arrival times into wall clock time.
+    int64_t startBoottimeNs;
+    int64_t startRealtimeNs;
+};
+
+enum TraceRecordType : uint32_t {
+    kTraceSensor = 1,
+    kTraceBatch = 2,
+};
+
+struct TraceRecordHeader {
+    uint32_t type;
+    // Bytes following this header.
+    uint32_t size;
+};
+
+// Followed by the name and typeAsString, without terminators.
+struct TraceSensor {
+    int32_t sensorHandle;
+    int32_t type;
+    uint32_t flags;
+    int32_t minDelay;
+    int32_t maxDelay;
+    uint32_t fifoReservedEventCount;
+    uint32_t fifoMaxEventCount;
+    float maxRange;
+    float resolution;
+    float power;
+    uint16_t nameLength;
+    uint16_t typeAsStringLength;
+};
+
+enum TraceBatchFlags : uint8_t {
+    // The sub-HAL posted the batch with a locked ScopedWakelock.
+    kTraceWakelockLocked = 1 << 0,
+};
+
+// Followed by numEvents events, exactly as the sub-HAL posted them.
+struct TraceBatch {
+    // CLOCK_BOOTTIME.
+    int64_t arrivalNs;
+    uint32_t wakelockRefCount;
+    uint32_t numEvents;
+    uint8_t subHalIndex;
+    uint8_t flags;
+    uint16_t reserved;
+};
+
+/**
+ * Writes the trace while recording is on. Batches are appended under a lock, recording is meant
+ * for debugging sessions only.
+ */
+class TraceRecorder {
+  public:
+    ~TraceRecorder();
+
+    bool start(const std::string& path, const std::map<int32_t, SensorInfo>& sensors);
+    void stop();
+
+    bool isRecording() const { return mRecording.load(std::memory_order_relaxed); }
+
+    void recordBatch(size_t subHalIndex, const std::vector<Event>& events, bool wakelockLocked,
+                     size_t wakelockRefCount);
+
+    /**
+     * Also pushes what was recorded so far to the file.
+     */
+    void dump(std::ostream& stream);
+
+  private:
+    void writeRecord(TraceRecordType type, const void* data, size_t size, const void* extra,
+                     size_t extraSize);
+
+    std::mutex mMutex;
+    FILE* mFile = nullptr;
+    std::string mPath;
+    std::atomic_bool mRecording = false;
+    uint64_t mNumBatches = 0;
+    uint64_t mNumEvents = 0;
+};
+
+/**
+ * Trace loaded into memory, for replaying it.
+ */
+struct Trace {
+    struct Batch {
+        TraceBatch header;
+        std::vector<Event> events;
+    };
+
+    TraceFileHeader header;
+    std::vector<SensorInfo> sensors;
+    std::vector<Batch> batches;
+
+    bool load(const std::string& path);
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
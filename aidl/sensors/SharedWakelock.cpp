@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SharedWakelock.h"
+
+#include "Clock.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+
+#include "hardware_legacy/power.h"
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void SharedWakelock::init(const char* name, int64_t timeoutNs) {
+    mName = name;
+    mTimeoutNs = timeoutNs;
+}
+
+int64_t SharedWakelock::acquire(size_t delta) {
+    int64_t now = getBoottimeNs();
+    int64_t start = mTimeoutStartNs.load();
+    while (start < now && !mTimeoutStartNs.compare_exchange_weak(start, now)) {
+    }
+    if (delta > 0 && mRefCount.fetch_add(delta) == 0) {
+        onTransition();
+    }
+    return now;
+}
+
+void SharedWakelock::release(size_t delta, int64_t timeoutStart) {
+    if (timeoutStart != -1 && timeoutStart < mTimeoutResetNs.load()) {
+        return;
+    }
+    size_t count = mRefCount.load();
+    while (count > 0 &&
+           !mRefCount.compare_exchange_weak(count, count - std::min(count, delta))) {
+    }
+    if (delta > count) {
+        ALOGE("Decrementing wakelock ref count by %zu when count is %zu", delta, count);
+    }
+    if (count > 0 && count <= delta) {
+        onTransition();
+    }
+}
+
+void SharedWakelock::reset() {
+    mTimeoutResetNs.store(getBoottimeNs());
+    if (mRefCount.exchange(0) > 0) {
+        onTransition();
+    }
+}
+
+bool SharedWakelock::didTimeout(int64_t* timeLeftNs) {
+    int64_t timeLeft = mTimeoutStartNs.load() + mTimeoutNs - getBoottimeNs();
+    if (timeLeft <= 0) {
+        return true;
+    }
+    *timeLeftNs = timeLeft;
+    return false;
+}
+
+void SharedWakelock::onTransition() {
+    bool acquired;
+    {
+        std::lock_guard<std::mutex> lock(mTransitionMutex);
+        // Whoever transitions last sees the final count, so every transition just makes the
+        // kernel wakelock match it.
+        bool wanted = mRefCount.load() > 0;
+        if (wanted == mHeld) {
+            return;
+        }
+        int64_t now = getBoottimeNs();
+        if (wanted) {
+            acquire_wake_lock(PARTIAL_WAKE_LOCK, mName);
+            mAcquiredNs = now;
+        } else {
+            release_wake_lock(mName);
+            holdUs.record((now - mAcquiredNs) / kNsPerUs);
+        }
+        mHeld = wanted;
+        acquired = wanted;
+    }
+    if (acquired) {
+        acquiredSignal.notify();
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "ConsumerSignal.h"
+#include "Histogram.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Reference counted wakelock shared by every wake up event in flight.
+ *
+ * The count is atomic, so taking or dropping references never locks. Only the 0 to 1 and 1 to 0
+ * transitions, which actually acquire or release the kernel wakelock, are serialized, and each
+ * re-checks the count under the lock so that racing transitions settle on the final count.
+ * Taking references only moves the CLOCK_BOOTTIME timeout start forward, the wakelock thread
+ * derives how long it may still wait from it.
+ */
+class SharedWakelock {
+  public:
+    SharedWakelock() = default;
+
+    SharedWakelock(const SharedWakelock&) = delete;
+    SharedWakelock& operator=(const SharedWakelock&) = delete;
+
+    /**
+     * Must be called before the first acquire().
+     */
+    void init(const char* name, int64_t timeoutNs);
+
+    /**
+     * Take delta references and restart the timeout.
+     *
+     * @return The time the timeout restarted at, to pass to release().
+     */
+    int64_t acquire(size_t delta);
+
+    /**
+     * Drop up to delta references, releasing the wakelock with the last one.
+     *
+     * @param timeoutStart What acquire() returned for these references, or -1. References taken
+     *         before the last reset() were already dropped and are ignored.
+     */
+    void release(size_t delta, int64_t timeoutStart = -1);
+
+    /**
+     * Drop every reference and release the wakelock.
+     */
+    void reset();
+
+    /**
+     * Wakelock thread: check whether the timeout expired.
+     *
+     * @param timeLeftNs Set to the time until the timeout if it did not expire.
+     */
+    bool didTimeout(int64_t* timeLeftNs);
+
+    size_t getRefCount() const { return mRefCount.load(std::memory_order_relaxed); }
+    int64_t getTimeoutStartNs() const { return mTimeoutStartNs.load(); }
+    int64_t getTimeoutResetNs() const { return mTimeoutResetNs.load(); }
+
+    // Wakes the wakelock thread once the wakelock is acquired.
+    ConsumerSignal acquiredSignal;
+    // How long the wakelock was held each time.
+    Log2Histogram holdUs;
+
+  private:
+    void onTransition();
+
+    const char* mName = nullptr;
+    int64_t mTimeoutNs = 0;
+
+    std::atomic<size_t> mRefCount = 0;
+    // CLOCK_BOOTTIME.
+    std::atomic<int64_t> mTimeoutStartNs = 0;
+    std::atomic<int64_t> mTimeoutResetNs = 0;
+
+    // Serializes acquiring and releasing the kernel wakelock.
+    std::mutex mTransitionMutex;
+    bool mHeld = false;
+    int64_t mAcquiredNs = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SubHalWatchdog.h"
+
+#include "Clock.h"
+
+#include <log/log.h>
+
+#include <cinttypes>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void SubHalWatchdog::setNumSubHals(size_t numSubHals) {
+    while (mStats.size() < numSubHals) {
+        mStats.emplace_back();
+    }
+}
+
+int64_t SubHalWatchdog::onCallbackStart(size_t subHalIndex) {
+    int64_t now = getMonotonicTimeNs();
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats != nullptr) {
+        stats->callbackStartNs.store(now, std::memory_order_relaxed);
+    }
+    return now;
+}
+
+void SubHalWatchdog::onCallbackEnd(size_t subHalIndex, int64_t startNs, size_t numEvents) {
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats == nullptr) {
+        return;
+    }
+    int64_t durationNs = getMonotonicTimeNs() - startNs;
+    stats->callbackStartNs.store(0, std::memory_order_relaxed);
+    stats->callbackDurationsUs.record(durationNs / kNsPerUs);
+    stats->batchSizes.record(numEvents);
+    stats->numEvents.fetch_add(numEvents, std::memory_order_relaxed);
+
+    int64_t longestNs = stats->longestCallbackNs.load(std::memory_order_relaxed);
+    while (durationNs > longestNs &&
+           !stats->longestCallbackNs.compare_exchange_weak(longestNs, durationNs)) {
+    }
+    if (durationNs >= kStallNs) {
+        stats->numStalls++;
+        ALOGW("Event callback of subhal %zu took %" PRId64 " ms for %zu events", subHalIndex,
+              durationNs / kNsPerMs, numEvents);
+    }
+}
+
+void SubHalWatchdog::onWakeupEvents(size_t subHalIndex, size_t numWakeupEvents) {
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats == nullptr || numWakeupEvents == 0) {
+        return;
+    }
+    stats->numWakeupBatches.fetch_add(1, std::memory_order_relaxed);
+    stats->numWakeupEvents.fetch_add(numWakeupEvents, std::memory_order_relaxed);
+}
+
+void SubHalWatchdog::checkFlooding(size_t subHalIndex, bool isAboveHighWater) {
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats == nullptr || stats->isFlooding.exchange(isAboveHighWater) == isAboveHighWater) {
+        return;
+    }
+    if (isAboveHighWater) {
+        stats->numFloods++;
+        ALOGW("Subhal %zu is flooding the event pipeline", subHalIndex);
+    }
+}
+
+void SubHalWatchdog::dump(std::ostream& stream, size_t subHalIndex) {
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats == nullptr) {
+        return;
+    }
+    stream << "  # of events posted: " << stats->numEvents << std::endl;
+    stream << "  # of wake up events posted: " << stats->numWakeupEvents << " in "
+           << stats->numWakeupBatches << " batches" << std::endl;
+    stream << "  Batch sizes:";
+    stats->batchSizes.dumpText(stream);
+    stream << std::endl;
+    stream << "  Event callback durations (us):";
+    stats->callbackDurationsUs.dumpText(stream);
+    stream << std::endl;
+    stream << "  Longest event callback: " << stats->longestCallbackNs / kNsPerUs << " us"
+           << std::endl;
+    int64_t callbackStartNs = stats->callbackStartNs;
+    if (callbackStartNs != 0) {
+        stream << "  Event callback running for "
+               << (getMonotonicTimeNs() - callbackStartNs) / kNsPerMs << " ms" << std::endl;
+    }
+    stream << "  # of stalled event callbacks: " << stats->numStalls
+           << ", # of times flooding: " << stats->numFloods
+           << (stats->isFlooding ? " (flooding now)" : "") << std::endl;
+}
+
+void SubHalWatchdog::dumpJson(std::ostream& stream, size_t subHalIndex) {
+    SubHalStats* stats = getStats(subHalIndex);
+    if (stats == nullptr) {
+        stream << "{}";
+        return;
+    }
+    stream << "{\"events\":" << stats->numEvents
+           << ",\"wakeup_events\":" << stats->numWakeupEvents
+           << ",\"wakeup_batches\":" << stats->numWakeupBatches << ",\"batch_sizes\":";
+    stats->batchSizes.dumpJson(stream);
+    stream << ",\"callback_us\":";
+    stats->callbackDurationsUs.dumpJson(stream);
+    stream << ",\"longest_callback_us\":" << stats->longestCallbackNs / kNsPerUs
+           << ",\"stalls\":" << stats->numStalls << ",\"floods\":" << stats->numFloods
+           << ",\"flooding\":" << (stats->isFlooding ? "true" : "false") << "}";
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "Histogram.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Keeps an eye on how each sub-HAL uses the event pipeline: how long its event callbacks take,
+ * and whether it floods its pending writes lane. Misbehaving sub-HALs are logged once per episode
+ * and counted, so that they can be told apart from the ones they slow down.
+ */
+class SubHalWatchdog {
+  public:
+    // Callbacks that take longer than this stall their sub-HAL's sensors.
+    static constexpr int64_t kStallNs = 100 * 1000 * 1000;
+
+    /**
+     * Only grows, must not be called once events flow.
+     */
+    void setNumSubHals(size_t numSubHals);
+
+    int64_t onCallbackStart(size_t subHalIndex);
+    void onCallbackEnd(size_t subHalIndex, int64_t startNs, size_t numEvents);
+
+    /**
+     * Account for wake up events posted by a sub-HAL, each of which holds the shared wakelock.
+     */
+    void onWakeupEvents(size_t subHalIndex, size_t numWakeupEvents);
+
+    /**
+     * Pending writes thread: report whether the lane of a sub-HAL is above high water.
+     */
+    void checkFlooding(size_t subHalIndex, bool isAboveHighWater);
+
+    void dump(std::ostream& stream, size_t subHalIndex);
+    void dumpJson(std::ostream& stream, size_t subHalIndex);
+
+  private:
+    struct SubHalStats {
+        Log2Histogram callbackDurationsUs;
+        Log2Histogram batchSizes;
+        std::atomic<uint64_t> numEvents = 0;
+        std::atomic<uint64_t> numWakeupBatches = 0;
+        std::atomic<uint64_t> numWakeupEvents = 0;
+        std::atomic<int64_t> longestCallbackNs = 0;
+        // Start of the callback in progress, 0 if there is none.
+        std::atomic<int64_t> callbackStartNs = 0;
+        std::atomic<uint64_t> numStalls = 0;
+        std::atomic<uint64_t> numFloods = 0;
+        std::atomic_bool isFlooding = false;
+    };
+
+    SubHalStats* getStats(size_t subHalIndex) {
+        return subHalIndex < mStats.size() ? &mStats[subHalIndex] : nullptr;
+    }
+
+    std::deque<SubHalStats> mStats;
+};
+
+/**
+ * Times a sub-HAL event callback for the watchdog.
+ */
+class ScopedCallbackTimer {
+  public:
+    ScopedCallbackTimer(SubHalWatchdog& watchdog, size_t subHalIndex, size_t numEvents)
+        : mWatchdog(watchdog), mSubHalIndex(subHalIndex), mNumEvents(numEvents) {
+        mStartNs = mWatchdog.onCallbackStart(mSubHalIndex);
+    }
+    ~ScopedCallbackTimer() { mWatchdog.onCallbackEnd(mSubHalIndex, mStartNs, mNumEvents); }
+
+    ScopedCallbackTimer(const ScopedCallbackTimer&) = delete;
+    ScopedCallbackTimer& operator=(const ScopedCallbackTimer&) = delete;
+
+  private:
+    SubHalWatchdog& mWatchdog;
+    size_t mSubHalIndex;
+    size_t mNumEvents;
+    int64_t mStartNs;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "TraceReplaySubHal.h"
+
+#include "Clock.h"
+
+#include <android-base/properties.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <sstream>
+
+using ::android::hardware::sensors::V2_1::implementation::ISensorsSubHal;
+using ::android::hardware::sensors::V2_1::subhal::implementation::TraceReplaySubHal;
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+using ::android::base::GetBoolProperty;
+using ::android::base::GetProperty;
+using ::android::base::GetUintProperty;
+using ::android::hardware::Void;
+using ::android::hardware::sensors::V1_0::MetaDataEventType;
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SensorStatus;
+using ::android::hardware::sensors::V2_0::implementation::ScopedWakelock;
+using ::android::hardware::sensors::V2_1::implementation::getBoottimeNs;
+using ::android::hardware::sensors::V2_1::implementation::kNsPerSec;
+using ::android::hardware::sensors::V2_1::implementation::kTraceWakelockLocked;
+
+static constexpr int32_t kBitsAfterSubHalIndex = 24;
+
+// QTI wise light, which the built-in sensor rules send through the ALS correction.
+static constexpr int32_t kSyntheticLightType = 33171103;
+
+// Type string prefix of the device private sensors that recorded sensors replay as.
+static constexpr char kReplayTypePrefix[] = "org.lineageos.sensor.replay.";
+
+static SensorInfo makeSyntheticSensor(int32_t sensorHandle, const std::string& name,
+                                      SensorType type, const std::string& typeAsString,
+                                      uint32_t flags, int32_t minDelayUs) {
+    SensorInfo sensor;
+    sensor.sensorHandle = sensorHandle;
+    sensor.name = name;
+    sensor.vendor = "LineageOS";
+    sensor.version = 1;
+    sensor.type = type;
+    sensor.typeAsString = typeAsString;
+    sensor.maxRange = 10000.0f;
+    sensor.resolution = 1.0f;
+    sensor.power = 0.001f;
+    sensor.minDelay = minDelayUs;
+    sensor.maxDelay = minDelayUs;
+    sensor.fifoReservedEventCount = 0;
+    sensor.fifoMaxEventCount = 0;
+    sensor.requiredPermission = "";
+    sensor.flags = flags;
+    return sensor;
+}
+
+/**
+ * Fill the trace with a synthetic load instead of a recording: num_sensors accelerometers sampling
+ * at rate_hz, the first wakeup_percent of them wakeup sensors, plus a QTI wise light sensor at the
+ * same rate unless light=false. Every sensor posts batch_size events at a time for duration_s
+ * seconds; batches larger than the FMQ keep HalProxy on its pending writes path.
+ */
+static bool generateSyntheticTrace(Trace* trace) {
+    uint32_t numSensors = GetUintProperty("vendor.sensors.replay.synthetic.num_sensors", 0u);
+    if (numSensors == 0) {
+        return false;
+    }
+    uint32_t rateHz =
+            std::max(GetUintProperty("vendor.sensors.replay.synthetic.rate_hz", 200u), 1u);
+    uint32_t wakeupPercent =
+            GetUintProperty("vendor.sensors.replay.synthetic.wakeup_percent", 10u, 100u);
+    uint32_t batchSize =
+            std::max(GetUintProperty("vendor.sensors.replay.synthetic.batch_size", 1u), 1u);
+    uint32_t durationS = GetUintProperty("vendor.sensors.replay.synthetic.duration_s", 10u);
+    bool light = GetBoolProperty("vendor.sensors.replay.synthetic.light", true);
+
+    int64_t periodNs = kNsPerSec / rateHz;
+    int32_t minDelayUs = static_cast<int32_t>(periodNs / 1000);
+    for (uint32_t i = 0; i < numSensors; i++) {
+        bool wakeup = i * 100 < wakeupPercent * numSensors;
+        trace->sensors.push_back(makeSyntheticSensor(
+                static_cast<int32_t>(i + 1), "Synthetic accelerometer " + std::to_string(i),
+                SensorType::ACCELEROMETER, "android.sensor.accelerometer",
+                wakeup ? static_cast<uint32_t>(SensorFlagBits::WAKE_UP) : 0, minDelayUs));
+    }
+    if (light) {
+        trace->sensors.push_back(makeSyntheticSensor(
+                static_cast<int32_t>(numSensors + 1), "Synthetic light",
+                static_cast<SensorType>(kSyntheticLightType), "qti.sensor.wise_light",
+                static_cast<uint32_t>(SensorFlagBits::ON_CHANGE_MODE), minDelayUs));
+    }
+
+    uint64_t numTicks = static_cast<uint64_t>(durationS) * rateHz / batchSize;
+    for (uint64_t tick = 0; tick < numTicks; tick++) {
+        int64_t arrivalNs = static_cast<int64_t>((tick + 1) * batchSize) * periodNs;
+        for (const SensorInfo& sensor : trace->sensors) {
+            bool wakeup = sensor.flags & SensorFlagBits::WAKE_UP;
+            Trace::Batch batch;
+            batch.header = {
+                    .arrivalNs = arrivalNs,
+                    .wakelockRefCount = 0,
+                    .numEvents = batchSize,
+                    .subHalIndex = 0,
+                    .flags = static_cast<uint8_t>(wakeup ? kTraceWakelockLocked : 0),
+                    .reserved = 0,
+            };
+            batch.events.resize(batchSize);
+            for (uint32_t i = 0; i < batchSize; i++) {
+                Event& event = batch.events[i];
+                event.sensorHandle = sensor.sensorHandle;
+                event.sensorType = sensor.type;
+                event.timestamp = arrivalNs - (batchSize - 1 - i) * periodNs;
+                event.u.data.fill(0.0f);
+                // Enough variation that on-change and correction logic have something to do.
+                float value = static_cast<float>((tick * batchSize + i) % 1000);
+                if (sensor.type == SensorType::ACCELEROMETER) {
+                    event.u.vec3.x = value / 100.0f;
+                    event.u.vec3.y = 9.81f;
+                    event.u.vec3.z = -value / 100.0f;
+                    event.u.vec3.status = SensorStatus::ACCURACY_HIGH;
+                } else {
+                    event.u.data[0] = value;
+                    event.u.data[2] = 1.0f;
+                }
+            }
+            trace->batches.push_back(std::move(batch));
+        }
+    }
+
+    ALOGI("Generated synthetic load: %u sensors at %u Hz, %u%% wakeup, %s light, %u events per "
+          "batch for %u s",
+          numSensors, rateHz, wakeupPercent, light ? "with" : "without", batchSize, durationS);
+    return true;
+}
+
+/**
+ * A trace lists the sensors as HalProxy exposed them, after the sensor rules, while its events are
+ * the raw ones of the sub-HALs. Replaying the sensors under their original types would make the
+ * rules match them again and apply their quirks a second time, so they become device private
+ * sensors that no rule matches. Synthetic sensors stand in for raw sub-HAL sensors and keep their
+ * types, the rules are part of the load they measure.
+ */
+static void retypeSensor(SensorInfo* sensor) {
+    sensor->type = SensorType::DEVICE_PRIVATE_BASE;
+    sensor->typeAsString = kReplayTypePrefix + std::string(sensor->typeAsString);
+}
+
+TraceReplaySubHal::TraceReplaySubHal()
+    : mRealtime(GetBoolProperty("vendor.sensors.replay.realtime", true)) {
+    std::string path = GetProperty("vendor.sensors.replay.trace_file", "");
+    bool synthetic = generateSyntheticTrace(&mTrace);
+    if (synthetic) {
+        path = "synthetic load";
+    } else if (path.empty() || !mTrace.load(path)) {
+        ALOGE("No sensor trace to replay");
+        return;
+    }
+
+    initializeSensorList(!synthetic);
+    ALOGI("Loaded sensor trace %s: %zu sensors, %zu batches", path.c_str(), mSensors.size(),
+          mTrace.batches.size());
+}
+
+TraceReplaySubHal::TraceReplaySubHal(Trace trace, bool realtime)
+    : mTrace(std::move(trace)), mRealtime(realtime) {
+    initializeSensorList(true /* retype */);
+}
+
+TraceReplaySubHal::~TraceReplaySubHal() {
+    stopReplay();
+}
+
+void TraceReplaySubHal::initializeSensorList(bool retype) {
+    int32_t nextHandle = 1;
+    for (SensorInfo sensor : mTrace.sensors) {
+        mHandles[sensor.sensorHandle] = nextHandle;
+        sensor.sensorHandle = nextHandle++;
+        sensor.name = "Replay " + std::string(sensor.name);
+        sensor.flags &=
+                ~(SensorFlagBits::MASK_DIRECT_REPORT | SensorFlagBits::MASK_DIRECT_CHANNEL);
+        if (retype) {
+            retypeSensor(&sensor);
+        }
+        mSensors.push_back(sensor);
+    }
+}
+
+Return<void> TraceReplaySubHal::getSensorsList_2_1(ISensors::getSensorsList_2_1_cb _hidl_cb) {
+    _hidl_cb(mSensors);
+    return Void();
+}
+
+Return<Result> TraceReplaySubHal::setOperationMode(OperationMode mode) {
+    return mode == OperationMode::NORMAL ? Result::OK : Result::BAD_VALUE;
+}
+
+const SensorInfo* TraceReplaySubHal::findSensor(int32_t sensorHandle) const {
+    if (sensorHandle <= 0 || sensorHandle > static_cast<int32_t>(mSensors.size())) {
+        return nullptr;
+    }
+    return &mSensors[sensorHandle - 1];
+}
+
+Return<Result> TraceReplaySubHal::activate(int32_t sensorHandle, bool /* enabled */) {
+    return findSensor(sensorHandle) != nullptr ? Result::OK : Result::BAD_VALUE;
+}
+
+Return<Result> TraceReplaySubHal::batch(int32_t sensorHandle, int64_t /* samplingPeriodNs */,
+                                        int64_t /* maxReportLatencyNs */) {
+    return activate(sensorHandle, true);
+}
+
+Return<Result> TraceReplaySubHal::flush(int32_t sensorHandle) {
+    const SensorInfo* sensor = findSensor(sensorHandle);
+    if (sensor == nullptr || mCallback == nullptr ||
+        (sensor->flags & SensorFlagBits::MASK_REPORTING_MODE) ==
+                static_cast<uint32_t>(SensorFlagBits::ONE_SHOT_MODE)) {
+        return Result::BAD_VALUE;
+    }
+
+    // Nothing is batched on this side, so the flush completes right away.
+    Event event = {};
+    event.sensorHandle = sensorHandle;
+    event.sensorType = SensorType::META_DATA;
+    event.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
+    std::vector<Event> events = {event};
+    mCallback->postEvents(events, mCallback->createScopedWakelock(false));
+    return Result::OK;
+}
+
+Return<Result> TraceReplaySubHal::injectSensorData_2_1(const Event& /* event */) {
+    return Result::INVALID_OPERATION;
+}
+
+Return<void> TraceReplaySubHal::registerDirectChannel(
+        const SharedMemInfo& /* mem */, ISensors::registerDirectChannel_cb _hidl_cb) {
+    _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
+    return Return<void>();
+}
+
+Return<Result> TraceReplaySubHal::unregisterDirectChannel(int32_t /* channelHandle */) {
+    return Result::INVALID_OPERATION;
+}
+
+Return<void> TraceReplaySubHal::configDirectReport(int32_t /* sensorHandle */,
+                                                   int32_t /* channelHandle */,
+                                                   RateLevel /* rate */,
+                                                   ISensors::configDirectReport_cb _hidl_cb) {
+    _hidl_cb(Result::INVALID_OPERATION, 0 /* reportToken */);
+    return Return<void>();
+}
+
+Return<void> TraceReplaySubHal::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) {
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
+        ALOGE("%s: missing fd for writing", __FUNCTION__);
+        return Void();
+    }
+
+    FILE* out = fdopen(dup(fd->data[0]), "w");
+
+    if (args.size() != 0) {
+        fprintf(out,
+                "Note: sub-HAL %s currently does not support args. Input arguments are "
+                "ignored.\n",
+                getName().c_str());
+    }
+
+    std::ostringstream stream;
+    stream << "Trace: " << mSensors.size() << " sensors, " << mTrace.batches.size()
+           << " batches, " << (mRealtime ? "original timing" : "as fast as possible") << std::endl;
+    int64_t durationNs = mReplayDurationNs;
+    if (durationNs == 0 && mReplayStartNs != 0) {
+        durationNs = getBoottimeNs() - mReplayStartNs;
+    }
+    stream << "Replayed: " << mNumBatchesReplayed << " batches, " << mNumEventsReplayed
+           << " events in " << durationNs / 1000000 << " ms";
+    if (durationNs > 0) {
+        stream << " (" << mNumEventsReplayed * kNsPerSec / durationNs << " events/s)";
+    }
+    stream << std::endl;
+    stream << "Delivery latency and allocations per event are in the HalProxy dump" << std::endl;
+
+    fprintf(out, "%s", stream.str().c_str());
+
+    fclose(out);
+    return Return<void>();
+}
+
+Return<Result> TraceReplaySubHal::initialize(const sp<IHalProxyCallback>& halProxyCallback) {
+    stopReplay();
+    mCallback = halProxyCallback;
+    startReplay();
+    return Result::OK;
+}
+
+void TraceReplaySubHal::startReplay() {
+    if (mTrace.batches.empty()) return;
+
+    mStopReplay = false;
+    mNumBatchesReplayed = 0;
+    mNumEventsReplayed = 0;
+    mReplayDurationNs = 0;
+    mReplayThread = std::thread([this] { replay(); });
+}
+
+void TraceReplaySubHal::stopReplay() {
+    {
+        std::lock_guard<std::mutex> lock(mReplayMutex);
+        mStopReplay = true;
+    }
+    mReplayCV.notify_all();
+    if (mReplayThread.joinable()) {
+        mReplayThread.join();
+    }
+}
+
+void TraceReplaySubHal::replay() {
+    int64_t traceStartNs = mTrace.batches.front().header.arrivalNs;
+    int64_t replayStartNs = getBoottimeNs();
+    mReplayStartNs = replayStartNs;
+    std::vector<Event> events;
+
+    for (const Trace::Batch& batch : mTrace.batches) {
+        {
+            std::unique_lock<std::mutex> lock(mReplayMutex);
+            if (mRealtime) {
+                int64_t delayNs =
+                        replayStartNs + (batch.header.arrivalNs - traceStartNs) - getBoottimeNs();
+                mReplayCV.wait_for(lock, std::chrono::nanoseconds(delayNs),
+                                   [&] { return mStopReplay; });
+            }
+            if (mStopReplay) break;
+        }
+
+        events.clear();
+        int64_t now = getBoottimeNs();
+        for (Event event : batch.events) {
+            int32_t tracedHandle =
+                    event.sensorHandle | (batch.header.subHalIndex << kBitsAfterSubHalIndex);
+            auto handle = mHandles.find(tracedHandle);
+            // Dynamic sensors are not part of the sensor list, so they cannot be replayed. The
+            // flush complete events answered flushes of the original session, flush() posts the
+            // ones of this session.
+            if (handle == mHandles.end() || event.sensorType == SensorType::DYNAMIC_SENSOR_META ||
+                event.sensorType == SensorType::META_DATA) {
+                continue;
+            }
+            event.sensorHandle = handle->second;
+            if (event.sensorType != SensorType::ADDITIONAL_INFO) {
+                event.sensorType = mSensors[handle->second - 1].type;
+            }
+            // Keep the original spacing of the samples when replaying at the original pace, else
+            // stamp them as they are posted so that the latency stats stay meaningful.
+            event.timestamp = mRealtime ? event.timestamp + (replayStartNs - traceStartNs) : now;
+            events.push_back(event);
+        }
+        if (events.empty()) continue;
+
+        ScopedWakelock wakelock =
+                mCallback->createScopedWakelock(batch.header.flags & kTraceWakelockLocked);
+        mCallback->postEvents(events, std::move(wakelock));
+        mNumBatchesReplayed++;
+        mNumEventsReplayed += events.size();
+    }
+
+    mReplayDurationNs = getBoottimeNs() - replayStartNs;
+    ALOGI("Replayed %" PRIu64 " batches in %" PRId64 " ms", mNumBatchesReplayed.load(),
+          mReplayDurationNs / 1000000);
+}
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+
+ISensorsSubHal* sensorsHalGetSubHal_2_1(uint32_t* version) {
+    static TraceReplaySubHal subHal;
+    *version = SUB_HAL_2_1_VERSION;
+    return &subHal;
+}
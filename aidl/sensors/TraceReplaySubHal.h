@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "SensorTrace.h"
+#include "V2_1/SubHal.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::OperationMode;
+using ::android::hardware::sensors::V1_0::RateLevel;
+using ::android::hardware::sensors::V1_0::Result;
+using ::android::hardware::sensors::V1_0::SharedMemInfo;
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::implementation::IHalProxyCallback;
+using ::android::hardware::sensors::V2_1::implementation::ISensorsSubHal;
+using ::android::hardware::sensors::V2_1::implementation::Trace;
+
+/**
+ * Sub-HAL that posts the events of a recorded sensor trace, to reproduce a field problem or load
+ * the HalProxy event pipeline without the original hardware. It advertises the traced sensors
+ * under new handles, as device private sensors so that the sensor rules do not apply twice, and
+ * replays every batch with its original wakelock state, either at the original pace or as fast as
+ * HalProxy takes them. Flushes complete right away.
+ *
+ * Listed in hals.conf like any other sub-HAL. The trace comes from the
+ * vendor.sensors.replay.trace_file property, vendor.sensors.replay.realtime=false drops the
+ * original timing.
+ *
+ * Setting vendor.sensors.replay.synthetic.num_sensors replaces the trace with a generated load,
+ * as a repeatable on-device throughput baseline for the event pipeline. The debug dump reports
+ * the events per second it achieved.
+ */
+class TraceReplaySubHal : public ISensorsSubHal {
+  public:
+    TraceReplaySubHal();
+    /**
+     * Replay a recorded trace that is already in memory instead of the one the properties name.
+     */
+    TraceReplaySubHal(Trace trace, bool realtime);
+    ~TraceReplaySubHal();
+
+    Return<void> getSensorsList_2_1(ISensors::getSensorsList_2_1_cb _hidl_cb);
+    Return<Result> injectSensorData_2_1(const Event& event);
+    Return<Result> initialize(const sp<IHalProxyCallback>& halProxyCallback);
+
+    virtual Return<Result> setOperationMode(OperationMode mode);
+
+    Return<Result> activate(int32_t sensorHandle, bool enabled);
+
+    Return<Result> batch(int32_t sensorHandle, int64_t samplingPeriodNs,
+                         int64_t maxReportLatencyNs);
+
+    Return<Result> flush(int32_t sensorHandle);
+
+    Return<void> registerDirectChannel(const SharedMemInfo& mem,
+                                       ISensors::registerDirectChannel_cb _hidl_cb);
+
+    Return<Result> unregisterDirectChannel(int32_t channelHandle);
+
+    Return<void> configDirectReport(int32_t sensorHandle, int32_t channelHandle, RateLevel rate,
+                                    ISensors::configDirectReport_cb _hidl_cb);
+
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args);
+
+    const std::string getName() { return "TraceReplaySubHal"; }
+
+  private:
+    void initializeSensorList(bool retype);
+    const SensorInfo* findSensor(int32_t sensorHandle) const;
+
+    void startReplay();
+    void stopReplay();
+    void replay();
+
+    Trace mTrace;
+    bool mRealtime;
+    std::vector<SensorInfo> mSensors;
+    // Traced handle, including the sub-HAL index, to replay handle.
+    std::map<int32_t, int32_t> mHandles;
+
+    sp<IHalProxyCallback> mCallback;
+
+    std::mutex mReplayMutex;
+    std::condition_variable mReplayCV;
+    bool mStopReplay = false;
+    std::thread mReplayThread;
+
+    std::atomic<uint64_t> mNumBatchesReplayed = 0;
+    std::atomic<uint64_t> mNumEventsReplayed = 0;
+    std::atomic<int64_t> mReplayStartNs = 0;
+    std::atomic<int64_t> mReplayDurationNs = 0;
+};
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
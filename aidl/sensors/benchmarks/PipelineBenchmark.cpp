@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AlsCorrection.h"
+#include "HalProxyCallback.h"
+#include "HalProxyState.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Heap allocations made anywhere in the process while a benchmark runs.
+static std::atomic<bool> sCountAllocations = false;
+static std::atomic<uint64_t> sNumAllocations = 0;
+
+void* operator new(size_t size) {
+    if (sCountAllocations.load(std::memory_order_relaxed)) {
+        sNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t /* size */) noexcept {
+    free(ptr);
+}
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V2_0::implementation::HalProxyCallbackV2_1;
+using ::android::hardware::sensors::V2_0::implementation::IScopedWakelockRefCounter;
+using ::android::hardware::sensors::V2_0::implementation::ISubHalCallback;
+using ::android::hardware::sensors::V2_0::implementation::ScopedWakelock;
+
+constexpr int32_t kBitsAfterSubHalIndex = SensorRegistry::kBitsAfterSubHalIndex;
+constexpr size_t kNumSubHals = 2;
+constexpr int32_t kMaxSensorsPerSubHal = 64;
+// Local handles of the first wake up and non-wake up sensor of every sub-HAL, and of the light
+// sensor of the first sub-HAL, the one with the ALS correction.
+constexpr int32_t kFirstWakeupHandle = 1;
+constexpr int32_t kFirstNonWakeupHandle = kFirstWakeupHandle + kMaxSensorsPerSubHal;
+constexpr int32_t kLightHandle = kFirstNonWakeupHandle + kMaxSensorsPerSubHal;
+// What the framework asks for.
+constexpr size_t kEventQueueSize = 256;
+// Simulated time every benchmark iteration stands for.
+constexpr int64_t kTickNs = 10 * kNsPerMs;
+constexpr auto kDrainTimeout = std::chrono::seconds(5);
+
+int32_t makeHandle(size_t subHalIndex, int32_t localHandle) {
+    return localHandle | static_cast<int32_t>(subHalIndex << kBitsAfterSubHalIndex);
+}
+
+/**
+ * Single producer, single consumer stand in for the event FMQ. Writers are serialized by the event
+ * queue writer, like they are in HalProxy.
+ */
+class FakeEventQueue : public IEventQueue {
+  public:
+    FakeEventQueue() : mEvents(kEventQueueSize) {}
+
+    size_t availableToWrite() override {
+        return kEventQueueSize - (mWritten.load() - mRead.load());
+    }
+
+    size_t getQuantumCount() override { return kEventQueueSize; }
+
+    bool write(const Event* events, size_t count) override {
+        if (count > availableToWrite()) {
+            return false;
+        }
+        uint64_t written = mWritten.load();
+        for (size_t i = 0; i < count; i++) {
+            mEvents[(written + i) % kEventQueueSize] = events[i];
+        }
+        mWritten.store(written + count);
+        return true;
+    }
+
+    void wakeReader() override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWakePending = true;
+        mWakeCV.notify_one();
+    }
+
+    bool waitForRead(int64_t timeoutNs) override {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mReadCV.wait_for(lock, std::chrono::nanoseconds(timeoutNs),
+                                [&] { return availableToWrite() > 0 || mStopped; });
+    }
+
+    /**
+     * Reader side: wait to be woken up, up to timeout, and read. Like the framework, the reader
+     * only looks at the FMQ once woken, so deferred wakes delay it.
+     */
+    size_t read(Event* out, size_t maxCount, std::chrono::microseconds timeout) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (!mWakeCV.wait_for(lock, timeout, [&] { return mWakePending; })) {
+                return 0;
+            }
+            mWakePending = false;
+        }
+        uint64_t read = mRead.load();
+        size_t count = std::min<size_t>(maxCount, mWritten.load() - read);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = mEvents[(read + i) % kEventQueueSize];
+        }
+        mRead.store(read + count);
+        if (count > 0) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mReadCV.notify_one();
+        }
+        return count;
+    }
+
+    /**
+     * Release the writer from waitForRead() for good.
+     */
+    void stop() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+        mReadCV.notify_one();
+    }
+
+    bool empty() const { return mWritten.load() == mRead.load(); }
+
+  private:
+    std::vector<Event> mEvents;
+    std::atomic<uint64_t> mWritten = 0;
+    std::atomic<uint64_t> mRead = 0;
+    std::mutex mMutex;
+    std::condition_variable mWakeCV;
+    std::condition_variable mReadCV;
+    bool mWakePending = false;
+    bool mStopped = false;
+};
+
+/**
+ * The part of HalProxy between the sub-HAL callbacks and the framework: the event queue writer
+ * HalProxy posts events through and runs the pending writes thread of, on top of a fake FMQ that a
+ * reader thread drains, optionally slowly.
+ */
+class FakeHalProxy : public ISubHalCallback, public IScopedWakelockRefCounter {
+  public:
+    explicit FakeHalProxy(int64_t readDelayUs) : mReadDelayUs(readDelayUs) {
+        HalProxyState& state = getHalProxyState();
+        auto eventQueue = std::make_unique<FakeEventQueue>();
+        mEventQueue = eventQueue.get();
+        state.eventQueueWriter.setEventQueue(std::move(eventQueue), this);
+        mNumWrittenFromBacklogAtStart = state.numEventsWrittenFromBacklog.load();
+        mThreadsRun = true;
+        mReaderThread = std::thread([this] { readEvents(); });
+        mPendingWritesThread = std::thread(
+                [this] { getHalProxyState().eventQueueWriter.handlePendingWrites(mThreadsRun); });
+    }
+
+    ~FakeHalProxy() {
+        HalProxyState& state = getHalProxyState();
+        mThreadsRun = false;
+        state.pendingWritesSignal.forceNotify();
+        mEventQueue->stop();
+        mReaderThread.join();
+        mPendingWritesThread.join();
+        state.clearPendingWrites();
+        state.eventQueueWriter.setEventQueue(nullptr, nullptr);
+    }
+
+    void postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
+                                  ScopedWakelock wakelock) override {
+        if (wakelock.isLocked()) {
+            incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
+        }
+        getHalProxyState().eventQueueWriter.postEvents(events, numWakeupEvents);
+    }
+
+    const SensorInfo& getSensorInfo(int32_t /* sensorHandle */) override { return mSensorInfo; }
+
+    bool areThreadsRunning() override { return mThreadsRun.load(); }
+
+    Return<void> onDynamicSensorsConnected(const hidl_vec<SensorInfo>& /* dynamicSensorsAdded */,
+                                           int32_t /* subHalIndex */) override {
+        return Return<void>();
+    }
+
+    Return<void> onDynamicSensorsDisconnected(
+            const hidl_vec<int32_t>& /* dynamicSensorHandlesRemoved */,
+            int32_t /* subHalIndex */) override {
+        return Return<void>();
+    }
+
+    bool incrementRefCountAndMaybeAcquireWakelock(size_t delta,
+                                                  int64_t* timeoutStart = nullptr) override {
+        mWakelockRefCount += delta;
+        if (timeoutStart != nullptr) {
+            *timeoutStart = getBoottimeNs();
+        }
+        return true;
+    }
+
+    void decrementRefCountAndMaybeReleaseWakelock(size_t delta,
+                                                  int64_t /* timeoutStart */ = -1) override {
+        mWakelockRefCount -= delta;
+    }
+
+    /**
+     * Wait for everything posted so far to be read.
+     */
+    void drain() {
+        auto deadline = std::chrono::steady_clock::now() + kDrainTimeout;
+        while ((getHalProxyState().hasPendingWrites() || !mEventQueue->empty()) &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t getNumRead() const { return mNumRead.load(); }
+    uint64_t getNumBacklogged() const {
+        return getHalProxyState().numEventsWrittenFromBacklog.load() -
+               mNumWrittenFromBacklogAtStart;
+    }
+    const Log2Histogram& getDeliveryLatencyUs() const { return mDeliveryLatencyUs; }
+
+  private:
+    // The framework: reads what fits in its buffer, acknowledges the wake up events, and takes
+    // mReadDelayUs to process them.
+    void readEvents() {
+        HalProxyState& state = getHalProxyState();
+        std::vector<Event> events(kEventQueueSize);
+        while (mThreadsRun.load()) {
+            size_t count = mEventQueue->read(events.data(), events.size(),
+                                             std::chrono::milliseconds(1));
+            int64_t now = getBoottimeNs();
+            size_t numWakeupEvents = 0;
+            for (size_t i = 0; i < count; i++) {
+                mDeliveryLatencyUs.record((now - events[i].timestamp) / kNsPerUs);
+                const SensorEntry* sensor = state.sensorRegistry.find(events[i].sensorHandle);
+                if (sensor != nullptr && sensor->isWakeup) {
+                    numWakeupEvents++;
+                }
+            }
+            mNumRead += count;
+            if (numWakeupEvents > 0) {
+                decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
+            }
+            if (count > 0 && mReadDelayUs > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(mReadDelayUs));
+            }
+        }
+    }
+
+    const int64_t mReadDelayUs;
+    // Owned by the event queue writer.
+    FakeEventQueue* mEventQueue;
+    uint64_t mNumWrittenFromBacklogAtStart = 0;
+    std::atomic_bool mThreadsRun = false;
+    std::thread mReaderThread;
+    std::thread mPendingWritesThread;
+
+    std::atomic<int64_t> mWakelockRefCount = 0;
+    std::atomic<uint64_t> mNumRead = 0;
+    Log2Histogram mDeliveryLatencyUs;
+    SensorInfo mSensorInfo;
+};
+
+SensorInfo makeSensor(size_t subHalIndex, int32_t localHandle, bool wakeup) {
+    SensorInfo sensor = {};
+    sensor.sensorHandle = makeHandle(subHalIndex, localHandle);
+    sensor.name = "sensor " + std::to_string(sensor.sensorHandle);
+    sensor.type = SensorType::ACCELEROMETER;
+    sensor.typeAsString = "android.sensor.accelerometer";
+    sensor.minDelay = 5000;
+    sensor.flags = wakeup ? static_cast<uint32_t>(SensorFlagBits::WAKE_UP) : 0;
+    return sensor;
+}
+
+/**
+ * The sensor list of both sub-HALs, built once for all benchmarks since the registry cannot be
+ * modified once events flow: kMaxSensorsPerSubHal wake up and as many non-wake up accelerometers
+ * each, and a QTI wise light on the first sub-HAL.
+ */
+void registerSensors() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        HalProxyState& state = getHalProxyState();
+        state.setNumSubHals(kNumSubHals);
+        for (size_t subHalIndex = 0; subHalIndex < kNumSubHals; subHalIndex++) {
+            for (int32_t i = 0; i < 2 * kMaxSensorsPerSubHal; i++) {
+                SensorInfo sensor = makeSensor(subHalIndex, kFirstWakeupHandle + i,
+                                               i < kMaxSensorsPerSubHal);
+                SensorEntry& entry = state.sensorRegistry.addSensor(sensor);
+                state.overflowPolicies.configure(sensor, &entry.overflow);
+            }
+        }
+
+        SensorInfo light = makeSensor(0, kLightHandle, false);
+        light.type = static_cast<SensorType>(SENSOR_TYPE_QTI_WISE_LIGHT);
+        light.typeAsString = "qti.sensor.wise_light";
+        light.flags = static_cast<uint32_t>(SensorFlagBits::ON_CHANGE_MODE);
+        SensorEntry& entry = state.sensorRegistry.addSensor(light);
+        state.overflowPolicies.configure(light, &entry.overflow);
+        state.alsScreen = std::make_shared<AlsScreen>();
+        entry.alsCorrection = std::make_unique<AlsCorrection>(light.name, "", state.alsScreen);
+        entry.alsCorrection->start();
+    });
+}
+
+/**
+ * Arguments: total number of sensors, rate of every sensor in Hz, percentage of wake up sensors,
+ * time the reader takes per read in us, and whether the light sensor posts too.
+ *
+ * Every iteration is one tick of kTickNs: each benchmark thread is a sub-HAL that posts a batch
+ * for every one of its sensors, with the samples the sensor took during the tick.
+ */
+class PipelineBenchmark : public benchmark::Fixture {
+  public:
+    void SetUp(benchmark::State& state) override {
+        if (state.thread_index() != 0) {
+            return;
+        }
+        registerSensors();
+        // Events posted before the correction is ready skip it.
+        const SensorEntry* light = getHalProxyState().sensorRegistry.find(0, kLightHandle);
+        auto deadline = std::chrono::steady_clock::now() + kDrainTimeout;
+        while (!light->alsCorrection->isReady() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mHalProxy = std::make_unique<FakeHalProxy>(state.range(3));
+        mNumPosted = 0;
+        sNumAllocations = 0;
+        sCountAllocations = true;
+    }
+
+    void TearDown(benchmark::State& state) override {
+        if (state.thread_index() != 0) {
+            return;
+        }
+        sCountAllocations = false;
+        mHalProxy->drain();
+        double numPosted = std::max<double>(1, mNumPosted.load());
+        const Log2Histogram& latencyUs = mHalProxy->getDeliveryLatencyUs();
+        state.counters["p50_us"] = latencyUs.getPercentile(0.5);
+        state.counters["p99_us"] = latencyUs.getPercentile(0.99);
+        state.counters["allocs_per_event"] = sNumAllocations.load() / numPosted;
+        state.counters["backlog_pct"] = 100.0 * mHalProxy->getNumBacklogged() / numPosted;
+        state.counters["delivered_pct"] = 100.0 * mHalProxy->getNumRead() / numPosted;
+        mHalProxy.reset();
+    }
+
+  protected:
+    /**
+     * @param paced Post every tick at its time, for the latency at the given load, rather than as
+     *              fast as the pipeline takes the events, for its throughput.
+     */
+    void postTicks(benchmark::State& state, bool paced) {
+        const size_t subHalIndex = state.thread_index();
+        const int32_t numSensors =
+                std::min<int32_t>(state.range(0) / kNumSubHals, kMaxSensorsPerSubHal);
+        const int64_t rateHz = state.range(1);
+        const int32_t numWakeupSensors = numSensors * state.range(2) / 100;
+        const bool withLight = state.range(4) != 0 && subHalIndex == 0;
+        const size_t numEventsPerTick = std::max<int64_t>(1, rateHz * kTickNs / kNsPerSec);
+
+        std::vector<int32_t> handles;
+        for (int32_t i = 0; i < numSensors; i++) {
+            handles.push_back(i < numWakeupSensors ? kFirstWakeupHandle + i
+                                                   : kFirstNonWakeupHandle + i - numWakeupSensors);
+        }
+        std::vector<Event> batch(numEventsPerTick);
+        std::vector<Event> lightBatch(1);
+        float value = 0;
+        // Thread 0 sets up the fake HalProxy, it is only known to be there once the loop started.
+        sp<HalProxyCallbackV2_1> callback;
+        auto nextTick = std::chrono::steady_clock::now();
+
+        for (auto _ : state) {
+            if (callback == nullptr) {
+                callback =
+                        new HalProxyCallbackV2_1(mHalProxy.get(), mHalProxy.get(), subHalIndex);
+            }
+            if (paced) {
+                std::this_thread::sleep_until(nextTick);
+                nextTick += std::chrono::nanoseconds(kTickNs);
+            }
+            for (int32_t i = 0; i < numSensors; i++) {
+                int64_t now = getBoottimeNs();
+                for (Event& event : batch) {
+                    event.sensorHandle = handles[i];
+                    event.sensorType = SensorType::ACCELEROMETER;
+                    event.timestamp = now;
+                    event.u.vec3.x = value;
+                    event.u.vec3.y = 9.81f;
+                    event.u.vec3.z = -value;
+                }
+                value += 0.01f;
+                callback->postEvents(batch,
+                                     callback->createScopedWakelock(i < numWakeupSensors));
+                mNumPosted += batch.size();
+            }
+            if (withLight) {
+                Event& event = lightBatch[0];
+                event.sensorHandle = kLightHandle;
+                event.sensorType = static_cast<SensorType>(SENSOR_TYPE_QTI_WISE_LIGHT);
+                event.timestamp = getBoottimeNs();
+                event.u.data.fill(0.0f);
+                event.u.data[0] = value;
+                event.u.data[2] = 1.0f;
+                callback->postEvents(lightBatch, callback->createScopedWakelock(false));
+                mNumPosted++;
+            }
+        }
+        state.SetItemsProcessed(state.iterations() *
+                                (numSensors * batch.size() + (withLight ? 1 : 0)));
+    }
+
+    std::unique_ptr<FakeHalProxy> mHalProxy;
+    std::atomic<uint64_t> mNumPosted = 0;
+};
+
+// Latency and cost per event at a given load: a second of ticks at their time.
+BENCHMARK_DEFINE_F(PipelineBenchmark, Paced)(benchmark::State& state) {
+    postTicks(state, true /* paced */);
+}
+
+BENCHMARK_REGISTER_F(PipelineBenchmark, Paced)
+        ->ArgNames({"sensors", "hz", "wakeup_pct", "read_delay_us", "als"})
+        // Every tick fits in the FMQ, even with a slow reader.
+        ->Args({8, 200, 0, 0, 0})
+        ->Args({32, 200, 10, 0, 0})
+        ->Args({32, 400, 10, 0, 1})
+        ->Args({64, 200, 10, 2000, 1})
+        // Ticks larger than the FMQ and a slow reader, so that most events take the pending
+        // writes path.
+        ->Args({64, 1000, 50, 2000, 1})
+        ->Threads(kNumSubHals)
+        ->Iterations(kNsPerSec / kTickNs)
+        ->UseRealTime();
+
+// Events per second the pipeline takes when the sub-HALs post back to back.
+BENCHMARK_DEFINE_F(PipelineBenchmark, Flood)(benchmark::State& state) {
+    postTicks(state, false /* paced */);
+}
+
+BENCHMARK_REGISTER_F(PipelineBenchmark, Flood)
+        ->ArgNames({"sensors", "hz", "wakeup_pct", "read_delay_us", "als"})
+        ->Args({32, 200, 10, 0, 1})
+        ->Args({32, 200, 10, 500, 1})
+        ->Threads(kNumSubHals)
+        ->UseRealTime();
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorRegistry.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+
+constexpr int32_t kBitsAfterSubHalIndex = SensorRegistry::kBitsAfterSubHalIndex;
+constexpr size_t kNumSubHals = 2;
+constexpr int32_t kSensorsPerSubHal = 24;
+constexpr size_t kBatchSize = 64;
+
+SensorInfo makeSensor(size_t subHalIndex, int32_t localHandle) {
+    SensorInfo sensor = {};
+    sensor.sensorHandle =
+            localHandle | static_cast<int32_t>(subHalIndex << kBitsAfterSubHalIndex);
+    sensor.name = "sensor " + std::to_string(sensor.sensorHandle);
+    switch (localHandle % 4) {
+        case 0:
+            sensor.type = SensorType::ACCELEROMETER;
+            sensor.typeAsString = "android.sensor.accelerometer";
+            break;
+        case 1:
+            sensor.type = SensorType::GLANCE_GESTURE;
+            sensor.typeAsString = "android.sensor.glance_gesture";
+            sensor.flags = static_cast<uint32_t>(SensorFlagBits::WAKE_UP);
+            break;
+        case 2:
+            sensor.type = SensorType::LIGHT;
+            sensor.typeAsString = "qti.sensor.lux_aod";
+            break;
+        default:
+            sensor.type = SensorType::GYROSCOPE;
+            sensor.typeAsString = "android.sensor.gyroscope";
+            break;
+    }
+    return sensor;
+}
+
+std::vector<SensorInfo> makeSensorList() {
+    std::vector<SensorInfo> sensors;
+    for (size_t subHalIndex = 0; subHalIndex < kNumSubHals; subHalIndex++) {
+        for (int32_t localHandle = 1; localHandle <= kSensorsPerSubHal; localHandle++) {
+            sensors.push_back(makeSensor(subHalIndex, localHandle));
+        }
+    }
+    return sensors;
+}
+
+// A batch as the second sub-HAL posts it, with local handles.
+std::vector<Event> makeBatch() {
+    std::vector<Event> events(kBatchSize);
+    for (size_t i = 0; i < events.size(); i++) {
+        events[i].sensorHandle = static_cast<int32_t>(i % kSensorsPerSubHal) + 1;
+        events[i].sensorType = SensorType::ACCELEROMETER;
+        events[i].u.scalar = static_cast<float>(i % 3);
+    }
+    return events;
+}
+
+// What the event path did per event before the registry: a map lookup by the full handle, then
+// type and type string compares to find out which quirks apply.
+void BM_MapLookup(benchmark::State& state) {
+    std::map<int32_t, SensorInfo> sensors;
+    for (const SensorInfo& sensor : makeSensorList()) {
+        sensors[sensor.sensorHandle] = sensor;
+    }
+    const std::vector<Event> batch = makeBatch();
+    const size_t subHalIndex = kNumSubHals - 1;
+
+    for (auto _ : state) {
+        size_t numWakeupEvents = 0;
+        size_t numKept = 0;
+        for (const Event& event : batch) {
+            int32_t sensorHandle =
+                    event.sensorHandle | static_cast<int32_t>(subHalIndex << kBitsAfterSubHalIndex);
+            const SensorInfo& sensor = sensors[sensorHandle];
+            if (sensor.type == SensorType::GLANCE_GESTURE && event.u.scalar != 2) {
+                continue;
+            }
+            if (sensor.type == SensorType::PICK_UP_GESTURE && event.u.scalar != 0) {
+                continue;
+            }
+            if (sensor.typeAsString == "qti.sensor.lux_aod") {
+                benchmark::DoNotOptimize(event.u.scalar);
+            }
+            if ((sensor.flags & SensorFlagBits::WAKE_UP) != 0) {
+                numWakeupEvents++;
+            }
+            numKept++;
+        }
+        benchmark::DoNotOptimize(numWakeupEvents);
+        benchmark::DoNotOptimize(numKept);
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_MapLookup);
+
+// The same work through the registry and the actions precomputed from the rules.
+void BM_RegistryLookup(benchmark::State& state) {
+    SensorRegistry registry;
+    for (const SensorInfo& sensor : makeSensorList()) {
+        SensorEntry& entry = registry.addSensor(sensor);
+        if (sensor.type == SensorType::GLANCE_GESTURE) {
+            entry.actions.hasValueFilter = true;
+            entry.actions.filterValue = 2;
+        }
+    }
+    const std::vector<Event> batch = makeBatch();
+    const size_t subHalIndex = kNumSubHals - 1;
+
+    for (auto _ : state) {
+        size_t numWakeupEvents = 0;
+        size_t numKept = 0;
+        for (const Event& event : batch) {
+            const SensorEntry* sensor = registry.find(subHalIndex, event.sensorHandle);
+            if (sensor == nullptr) {
+                continue;
+            }
+            const SensorEventActions& actions = sensor->actions;
+            if (actions.hasValueFilter && event.u.scalar != actions.filterValue) {
+                continue;
+            }
+            if (actions.nodeFd >= 0) {
+                benchmark::DoNotOptimize(event.u.scalar);
+            }
+            if (sensor->isWakeup) {
+                numWakeupEvents++;
+            }
+            numKept++;
+        }
+        benchmark::DoNotOptimize(numWakeupEvents);
+        benchmark::DoNotOptimize(numKept);
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_RegistryLookup);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
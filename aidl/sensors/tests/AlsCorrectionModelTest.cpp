@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AlsCorrectionModel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+// A made up calibration in the range of the ones the devices ship.
+constexpr float kPoly[4][4] = {
+        {1e-6f, -2e-4f, 0.05f, 0.1f},
+        {2e-6f, -1e-4f, 0.04f, 0.0f},
+        {-1e-6f, 3e-4f, 0.02f, 0.2f},
+        {5e-7f, 1e-4f, 0.01f, 0.05f},
+};
+constexpr float kPostmul[4] = {1.2f, 0.9f, 0.7f, 0.5f};
+constexpr float kGrayscaleWeights[3] = {0.3f, 0.59f, 0.11f};
+constexpr float kMaxLuxWhite = 400.0f;
+constexpr float kMaxBrightness = 1023.0f;
+
+// The tables are interpolated between whole channel values.
+constexpr float kToleranceLux = 0.01f;
+
+/**
+ * The model as the correction evaluated it before it was tabulated, polynomials and all, per
+ * event.
+ */
+float getReferenceScreenLux(float r, float g, float b, float brightness) {
+    float rgbw[4] = {r, g, b,
+                     r * kGrayscaleWeights[0] + g * kGrayscaleWeights[1] +
+                             b * kGrayscaleWeights[2]};
+    float lux = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        float channelLux = 0.0f;
+        for (float coefficient : kPoly[i]) {
+            channelLux = channelLux * rgbw[i] + coefficient;
+        }
+        channelLux *= kPostmul[i];
+        if (i < 3) {
+            lux += std::max(channelLux, 0.0f);
+        } else {
+            lux -= channelLux;
+        }
+    }
+    float fullWhiteLux = kMaxLuxWhite * brightness / kMaxBrightness;
+    lux = std::min(lux * brightness / kMaxBrightness, fullWhiteLux);
+    return std::max(lux, static_cast<float>(std::pow(rgbw[3] / 255.0, 2.2) * fullWhiteLux));
+}
+
+class AlsCorrectionModelTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mModel.init(kPoly, kPostmul, kGrayscaleWeights, kMaxLuxWhite, kMaxBrightness);
+    }
+
+    AlsCorrectionModel mModel;
+};
+
+TEST_F(AlsCorrectionModelTest, MatchesGoldenValues) {
+    static const struct {
+        float r, g, b, brightness;
+        float lux;
+    } kGolden[] = {
+            // Full white is clamped to the white output at any brightness.
+            {255, 255, 255, 1023, 400.0000f},
+            {255, 255, 255, 511.5f, 200.0000f},
+            {0, 0, 0, 1023, 0.2350f},
+            // Primaries, the red one is floored to the gamma estimate.
+            {255, 0, 0, 1023, 28.2961f},
+            {0, 255, 0, 1023, 125.2952f},
+            {0, 0, 255, 1023, 5.6682f},
+            {128, 128, 128, 1023, 87.8079f},
+            // Fractional averages between table entries.
+            {200, 40, 90.5f, 700, 30.1468f},
+            {17.25f, 99.75f, 180.5f, 300, 10.1623f},
+            {64, 32, 16, 1023, 6.7356f},
+            {255, 128, 0, 1, 0.1253f},
+    };
+    for (const auto& golden : kGolden) {
+        EXPECT_NEAR(mModel.getScreenLux(golden.r, golden.g, golden.b, golden.brightness),
+                    golden.lux, kToleranceLux)
+                << "rgb " << golden.r << " " << golden.g << " " << golden.b << " brightness "
+                << golden.brightness;
+    }
+}
+
+TEST_F(AlsCorrectionModelTest, MatchesReferenceAcrossColorsAndBrightness) {
+    for (float r = 0; r <= 255; r += 7.3f) {
+        for (float g = 0; g <= 255; g += 11.1f) {
+            for (float b = 0; b <= 255; b += 13.7f) {
+                for (float brightness : {10.0f, 500.0f, 1023.0f}) {
+                    ASSERT_NEAR(mModel.getScreenLux(r, g, b, brightness),
+                                getReferenceScreenLux(r, g, b, brightness), kToleranceLux)
+                            << "rgb " << r << " " << g << " " << b << " brightness "
+                            << brightness;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(AlsCorrectionModelTest, AddsNothingWithTheBacklightOff) {
+    EXPECT_EQ(mModel.getScreenLux(255, 255, 255, 0), 0.0f);
+    EXPECT_EQ(mModel.getScreenLux(100, 50, 25, 0), 0.0f);
+}
+
+TEST_F(AlsCorrectionModelTest, AddsNothingWithoutMaxBrightness) {
+    AlsCorrectionModel model;
+    model.init(kPoly, kPostmul, kGrayscaleWeights, kMaxLuxWhite, 0.0f);
+    EXPECT_EQ(model.getScreenLux(255, 255, 255, 500), 0.0f);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
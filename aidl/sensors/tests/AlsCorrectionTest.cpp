@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AlsCorrection.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::AdditionalInfoType;
+using ::android::hardware::sensors::V1_0::MetaDataEventType;
+
+constexpr auto kInitTimeout = std::chrono::seconds(5);
+
+Event makeLightEvent(float lux) {
+    Event event = {};
+    event.sensorHandle = 1;
+    event.sensorType = static_cast<SensorType>(SENSOR_TYPE_QTI_WISE_LIGHT);
+    event.u.data[0] = lux;
+    event.u.data[2] = 1;
+    return event;
+}
+
+class AlsCorrectionTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mCorrection = std::make_unique<AlsCorrection>("light", "", std::make_shared<AlsScreen>());
+        mCorrection->start();
+        auto deadline = std::chrono::steady_clock::now() + kInitTimeout;
+        while (!mCorrection->isReady() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_TRUE(mCorrection->isReady());
+    }
+
+    std::string dump() {
+        std::ostringstream stream;
+        mCorrection->dump(stream);
+        return stream.str();
+    }
+
+    std::unique_ptr<AlsCorrection> mCorrection;
+};
+
+TEST_F(AlsCorrectionTest, MetaEventsPassThroughUnchanged) {
+    // The first sample starts the decimation interval, anything else within it is too fast.
+    Event sample = makeLightEvent(100);
+    mCorrection->process(sample);
+
+    Event flushComplete = makeLightEvent(0);
+    flushComplete.sensorType = SensorType::META_DATA;
+    flushComplete.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
+    EXPECT_TRUE(mCorrection->process(flushComplete));
+    EXPECT_EQ(flushComplete.sensorType, SensorType::META_DATA);
+    EXPECT_EQ(flushComplete.u.meta.what, MetaDataEventType::META_DATA_FLUSH_COMPLETE);
+
+    Event additionalInfo = makeLightEvent(0);
+    additionalInfo.sensorType = SensorType::ADDITIONAL_INFO;
+    additionalInfo.u.additional.type = AdditionalInfoType::AINFO_SENSOR_PLACEMENT;
+    additionalInfo.u.additional.u.data_float[0] = 42;
+    EXPECT_TRUE(mCorrection->process(additionalInfo));
+    EXPECT_EQ(additionalInfo.u.additional.type, AdditionalInfoType::AINFO_SENSOR_PLACEMENT);
+    EXPECT_EQ(additionalInfo.u.additional.u.data_float[0], 42);
+    EXPECT_NE(dump().find("dropped 0 too fast"), std::string::npos);
+
+    // Samples are still decimated.
+    sample = makeLightEvent(200);
+    EXPECT_FALSE(mCorrection->process(sample));
+    EXPECT_NE(dump().find("dropped 1 too fast"), std::string::npos);
+}
+
+// A correction may go away before init() is done, along with its screen.
+TEST(AlsCorrectionLifetimeTest, CanBeDestroyedWhileStarting) {
+    for (int i = 0; i < 20; i++) {
+        auto correction =
+                std::make_unique<AlsCorrection>("light", "", std::make_shared<AlsScreen>());
+        correction->start();
+        correction.reset();
+    }
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
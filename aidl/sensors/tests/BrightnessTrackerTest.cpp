@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "BrightnessTracker.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+constexpr auto kTimeout = std::chrono::seconds(5);
+
+/**
+ * A backlight device without actual_brightness, so that changes are only caught by polling.
+ */
+class BrightnessTrackerTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        char dir[] = "/tmp/BrightnessTrackerTest.XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        mDir = std::string(dir) + "/";
+        setBrightness(100);
+    }
+
+    void TearDown() override {
+        unlink((mDir + "brightness").c_str());
+        rmdir(mDir.c_str());
+    }
+
+    void setBrightness(int brightness) {
+        std::ofstream file(mDir + "brightness", std::ios::trunc);
+        file << brightness << std::endl;
+    }
+
+    std::string mDir;
+};
+
+TEST_F(BrightnessTrackerTest, PicksUpChangesByPolling) {
+    BrightnessTracker tracker;
+    ASSERT_TRUE(tracker.start(mDir));
+    EXPECT_EQ(tracker.getBrightness(INT64_MAX), 100);
+
+    setBrightness(200);
+    auto deadline = std::chrono::steady_clock::now() + kTimeout;
+    while (tracker.getBrightness(INT64_MAX) != 200 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(tracker.getBrightness(INT64_MAX), 200);
+    // Older samples keep the brightness they had.
+    EXPECT_EQ(tracker.getBrightness(0), 100);
+}
+
+TEST_F(BrightnessTrackerTest, StopsWithoutWaitingForThePoll) {
+    auto tracker = std::make_unique<BrightnessTracker>();
+    ASSERT_TRUE(tracker->start(mDir));
+    // Let the thread get into poll().
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    tracker.reset();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+}
+
+TEST_F(BrightnessTrackerTest, FailsWithoutABrightnessNode) {
+    BrightnessTracker tracker;
+    EXPECT_FALSE(tracker.start(mDir + "missing/"));
+    EXPECT_EQ(tracker.getBrightness(INT64_MAX), 0);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DirectChannelRouter.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SharedMemType;
+
+constexpr uint32_t kDirectReportFast = 2 << 7;
+constexpr uint32_t kAshmem = static_cast<uint32_t>(SensorFlagBits::DIRECT_CHANNEL_ASHMEM);
+constexpr uint32_t kGralloc = static_cast<uint32_t>(SensorFlagBits::DIRECT_CHANNEL_GRALLOC);
+
+SensorInfo makeSensor(uint32_t flags) {
+    SensorInfo sensor = {};
+    sensor.flags = flags;
+    return sensor;
+}
+
+TEST(DirectChannelRouterTest, FirstSubHalSupportingAMemoryTypeServesIt) {
+    DirectChannelRouter router;
+    EXPECT_FALSE(router.getSubHalIndex(SharedMemType::ASHMEM).has_value());
+
+    SensorInfo plain = makeSensor(0);
+    router.addSensor(0, &plain);
+    SensorInfo gyro = makeSensor(kDirectReportFast | kAshmem);
+    router.addSensor(1, &gyro);
+    SensorInfo accel = makeSensor(kDirectReportFast | kAshmem);
+    router.addSensor(1, &accel);
+    SensorInfo virtualSensor = makeSensor(kDirectReportFast | kAshmem | kGralloc);
+    router.addSensor(2, &virtualSensor);
+
+    EXPECT_EQ(router.getSubHalIndex(SharedMemType::ASHMEM), 1u);
+    EXPECT_EQ(router.getSubHalIndex(SharedMemType::GRALLOC), 2u);
+    // Every sensor of the serving sub-HAL can go on the same channel.
+    EXPECT_EQ(gyro.flags, kDirectReportFast | kAshmem);
+    EXPECT_EQ(accel.flags, kDirectReportFast | kAshmem);
+    // The other sub-HALs keep the types nobody else serves.
+    EXPECT_EQ(virtualSensor.flags, kDirectReportFast | kGralloc);
+    EXPECT_EQ(plain.flags, 0u);
+}
+
+TEST(DirectChannelRouterTest, StripsDirectReportFromSensorsLeftWithoutAChannelType) {
+    DirectChannelRouter router;
+    SensorInfo first = makeSensor(kDirectReportFast | kAshmem);
+    router.addSensor(0, &first);
+    SensorInfo second = makeSensor(kDirectReportFast | kAshmem |
+                                   static_cast<uint32_t>(SensorFlagBits::WAKE_UP));
+    router.addSensor(1, &second);
+
+    EXPECT_EQ(second.flags, static_cast<uint32_t>(SensorFlagBits::WAKE_UP));
+    EXPECT_FALSE(router.getSubHalIndex(SharedMemType::GRALLOC).has_value());
+}
+
+TEST(DirectChannelRouterTest, TranslatesChannelHandles) {
+    DirectChannelRouter router;
+    // Both sub-HALs hand out their own first handle.
+    int32_t ashmemChannel = router.addChannel({.subHalIndex = 1, .subHalChannelHandle = 1});
+    int32_t grallocChannel = router.addChannel({.subHalIndex = 2, .subHalChannelHandle = 1});
+    EXPECT_NE(ashmemChannel, grallocChannel);
+
+    DirectChannelRouter::Channel channel;
+    ASSERT_TRUE(router.findChannel(grallocChannel, &channel));
+    EXPECT_EQ(channel.subHalIndex, 2u);
+    EXPECT_EQ(channel.subHalChannelHandle, 1);
+    EXPECT_FALSE(router.findChannel(grallocChannel + ashmemChannel, &channel));
+
+    ASSERT_TRUE(router.removeChannel(ashmemChannel, &channel));
+    EXPECT_EQ(channel.subHalIndex, 1u);
+    EXPECT_FALSE(router.findChannel(ashmemChannel, &channel));
+    EXPECT_FALSE(router.removeChannel(ashmemChannel, &channel));
+    // Handles are not reused, so a stale one never reaches another channel.
+    EXPECT_NE(router.addChannel({.subHalIndex = 1, .subHalChannelHandle = 2}), ashmemChannel);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EventQueueWriter.h"
+
+#include "FakeHalProxy.h"
+#include "HalProxyState.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+constexpr size_t kNumSubHals = 3;
+constexpr auto kTimeout = std::chrono::seconds(5);
+
+Event makeEvent(size_t subHalIndex, int32_t localHandle) {
+    Event event = {};
+    int32_t subHalBits = static_cast<int32_t>(subHalIndex << SensorRegistry::kBitsAfterSubHalIndex);
+    event.sensorHandle = localHandle | subHalBits;
+    event.sensorType = SensorType::ACCELEROMETER;
+    return event;
+}
+
+/**
+ * An event FMQ of fixed capacity that records every write, and is only ever read by the test.
+ */
+class RecordingEventQueue : public IEventQueue {
+  public:
+    explicit RecordingEventQueue(size_t capacity) : mCapacity(capacity) {}
+
+    size_t availableToWrite() override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCapacity - mEvents.size();
+    }
+
+    size_t getQuantumCount() override { return mCapacity; }
+
+    bool write(const Event* events, size_t count) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (count > mCapacity - mEvents.size()) {
+            return false;
+        }
+        mEvents.insert(mEvents.end(), events, events + count);
+        mWriteSizes.push_back(count);
+        mCV.notify_all();
+        return true;
+    }
+
+    void wakeReader() override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNumWakes++;
+    }
+
+    // Nobody reads, so every wait times out, right away.
+    bool waitForRead(int64_t /* timeoutNs */) override {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNumReadTimeouts++;
+        mCV.notify_all();
+        return false;
+    }
+
+    bool waitForEvents(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCV.wait_for(lock, kTimeout, [&] { return mEvents.size() >= count; });
+    }
+
+    bool waitForReadTimeout() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCV.wait_for(lock, kTimeout, [&] { return mNumReadTimeouts > 0; });
+    }
+
+    std::vector<Event> getEvents() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEvents;
+    }
+
+    std::vector<size_t> getWriteSizes() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWriteSizes;
+    }
+
+    size_t getNumWakes() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNumWakes;
+    }
+
+  private:
+    const size_t mCapacity;
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::vector<Event> mEvents;
+    std::vector<size_t> mWriteSizes;
+    size_t mNumWakes = 0;
+    size_t mNumReadTimeouts = 0;
+};
+
+class EventQueueWriterTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        HalProxyState& state = getHalProxyState();
+        state.setNumSubHals(kNumSubHals);
+        state.clearPendingWrites();
+        state.nextSubHalLane = 0;
+    }
+
+    void TearDown() override {
+        stopPendingWritesThread();
+        getHalProxyState().clearPendingWrites();
+        mWriter.setEventQueue(nullptr, nullptr);
+    }
+
+    RecordingEventQueue* attachEventQueue(size_t capacity) {
+        auto eventQueue = std::make_unique<RecordingEventQueue>(capacity);
+        RecordingEventQueue* recordingQueue = eventQueue.get();
+        mWriter.setEventQueue(std::move(eventQueue), &mHalProxy);
+        return recordingQueue;
+    }
+
+    void startPendingWritesThread() {
+        mThreadsRun = true;
+        mPendingWritesThread = std::thread([this] { mWriter.handlePendingWrites(mThreadsRun); });
+    }
+
+    void stopPendingWritesThread() {
+        if (mPendingWritesThread.joinable()) {
+            mThreadsRun = false;
+            getHalProxyState().pendingWritesSignal.forceNotify();
+            mPendingWritesThread.join();
+        }
+    }
+
+    EventQueueWriter mWriter;
+    FakeHalProxy mHalProxy;
+    std::atomic_bool mThreadsRun = false;
+    std::thread mPendingWritesThread;
+};
+
+TEST_F(EventQueueWriterTest, WritesDirectlyWhenNothingIsPending) {
+    RecordingEventQueue* eventQueue = attachEventQueue(8);
+
+    mWriter.postEvents({makeEvent(0, 1), makeEvent(0, 2)}, 0);
+
+    EXPECT_EQ(eventQueue->getEvents().size(), 2u);
+    EXPECT_EQ(eventQueue->getNumWakes(), 1u);
+    EXPECT_FALSE(getHalProxyState().hasPendingWrites());
+}
+
+TEST_F(EventQueueWriterTest, QueuesWhatDoesNotFitWakeupEventsFirst) {
+    HalProxyState& state = getHalProxyState();
+    RecordingEventQueue* eventQueue = attachEventQueue(1);
+
+    mWriter.postEvents({makeEvent(1, 1), makeEvent(1, 2), makeEvent(1, 3), makeEvent(1, 4)},
+                       2 /* numWakeupEvents */);
+
+    EXPECT_EQ(eventQueue->getEvents().size(), 1u);
+    EXPECT_EQ(state.pendingWrites[kWakeupLane].events.size(), 1u);
+    EXPECT_EQ(state.pendingWrites[state.getSubHalLaneIndex(1)].events.size(), 2u);
+
+    // Once something is pending, everything goes behind it to keep the order.
+    mWriter.postEvents({makeEvent(2, 1)}, 0);
+    EXPECT_EQ(eventQueue->getEvents().size(), 1u);
+    EXPECT_EQ(state.pendingWrites[state.getSubHalLaneIndex(2)].events.size(), 1u);
+}
+
+// Only the sub-HALs with events pending share the room in the FMQ, so a single busy sub-HAL gets
+// all of it in one write.
+TEST_F(EventQueueWriterTest, SharesTheFmqBetweenBusySubHalsOnly) {
+    HalProxyState& state = getHalProxyState();
+    RecordingEventQueue* eventQueue = attachEventQueue(12);
+    // More than fits, so that the thread ends up waiting for the reader.
+    std::vector<Event> events(14, makeEvent(1, 1));
+    ASSERT_EQ(state.queuePendingWrites(state.getSubHalLaneIndex(1), events.data(), 14), 0u);
+
+    startPendingWritesThread();
+    ASSERT_TRUE(eventQueue->waitForReadTimeout());
+    stopPendingWritesThread();
+
+    EXPECT_EQ(eventQueue->getWriteSizes(), std::vector<size_t>({12}));
+    EXPECT_GE(eventQueue->getNumWakes(), 1u);
+}
+
+TEST_F(EventQueueWriterTest, DrainsTheWakeupLaneFirst) {
+    HalProxyState& state = getHalProxyState();
+    RecordingEventQueue* eventQueue = attachEventQueue(4);
+    Event nonWakeupEvent = makeEvent(0, 1);
+    Event wakeupEvent = makeEvent(0, 2);
+    ASSERT_EQ(state.queuePendingWrites(state.getSubHalLaneIndex(0), &nonWakeupEvent, 1), 0u);
+    ASSERT_EQ(state.queuePendingWrites(kWakeupLane, &wakeupEvent, 1), 0u);
+
+    startPendingWritesThread();
+    ASSERT_TRUE(eventQueue->waitForEvents(2));
+    stopPendingWritesThread();
+
+    std::vector<Event> written = eventQueue->getEvents();
+    EXPECT_EQ(written[0].sensorHandle, wakeupEvent.sensorHandle);
+    EXPECT_EQ(written[1].sensorHandle, nonWakeupEvent.sensorHandle);
+}
+
+// On a full FMQ that the reader does not drain in time, the longest sub-HAL backlog goes first and
+// wake up events last, giving their wakelock share back.
+TEST_F(EventQueueWriterTest, DropsTheLongestBacklogFirstWhenTheReaderTimesOut) {
+    HalProxyState& state = getHalProxyState();
+    RecordingEventQueue* eventQueue = attachEventQueue(1);
+    std::vector<Event> events(3, makeEvent(0, 1));
+    ASSERT_TRUE(eventQueue->write(events.data(), 1));
+    size_t subHalLane = state.getSubHalLaneIndex(0);
+    ASSERT_EQ(state.queuePendingWrites(subHalLane, events.data(), 3), 0u);
+    ASSERT_EQ(state.queuePendingWrites(kWakeupLane, events.data(), 2), 0u);
+    mHalProxy.incrementRefCountAndMaybeAcquireWakelock(2);
+    uint64_t numDropped = state.pendingWrites[subHalLane].numDropped;
+    uint64_t numWakeupDropped = state.pendingWrites[kWakeupLane].numDropped;
+
+    startPendingWritesThread();
+    auto deadline = std::chrono::steady_clock::now() + kTimeout;
+    while (state.hasPendingWrites() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stopPendingWritesThread();
+
+    EXPECT_FALSE(state.hasPendingWrites());
+    EXPECT_EQ(state.pendingWrites[subHalLane].numDropped, numDropped + 3);
+    EXPECT_EQ(state.pendingWrites[kWakeupLane].numDropped, numWakeupDropped + 2);
+    EXPECT_EQ(mHalProxy.getWakelockRefCount(), 0u);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EventRing.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+/**
+ * Read everything that is published, in up to two runs like the pending writes thread.
+ */
+std::vector<int> drain(EventRing<int>& ring) {
+    std::vector<int> items;
+    for (int run = 0; run < 2; run++) {
+        int* first;
+        size_t count = ring.peek(ring.capacity(), &first);
+        items.insert(items.end(), first, first + count);
+        ring.consume(count);
+    }
+    return items;
+}
+
+TEST(EventRingTest, RoundsCapacityUpToAPowerOfTwo) {
+    EXPECT_EQ(EventRing<int>(1).capacity(), 1u);
+    EXPECT_EQ(EventRing<int>(5).capacity(), 8u);
+    EXPECT_EQ(EventRing<int>(64).capacity(), 64u);
+}
+
+TEST(EventRingTest, PushesAndPeeksInOrder) {
+    EventRing<int> ring(8);
+    const int items[] = {1, 2, 3};
+    ASSERT_TRUE(ring.push(items, 3, 42));
+    EXPECT_EQ(ring.size(), 3u);
+
+    int* first;
+    ASSERT_EQ(ring.peek(2, &first), 2u);
+    EXPECT_EQ(first[0], 1);
+    EXPECT_EQ(first[1], 2);
+    EXPECT_EQ(ring.getStamp(&first[1]), 42);
+    ring.consume(2);
+
+    EXPECT_EQ(drain(ring), std::vector<int>({3}));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(EventRingTest, RejectsWhatDoesNotFit) {
+    EventRing<int> ring(4);
+    const int items[] = {1, 2, 3, 4, 5};
+    EXPECT_FALSE(ring.push(items, 5));
+    ASSERT_TRUE(ring.push(items, 3));
+    EXPECT_FALSE(ring.push(items, 2));
+    EXPECT_FALSE(ring.reserve(2));
+    EXPECT_EQ(ring.size(), 3u);
+    // Nothing was written by the failed attempts.
+    EXPECT_EQ(drain(ring), std::vector<int>({1, 2, 3}));
+    EXPECT_TRUE(ring.push(items, 4));
+}
+
+TEST(EventRingTest, SkipsUnusedSlotsOfAReservation) {
+    EventRing<int> ring(8);
+    auto reservation = ring.reserve(4);
+    ASSERT_TRUE(reservation);
+    ring.slot(reservation, 0) = 10;
+    ring.slot(reservation, 1) = 11;
+    ring.commit(reservation, 2);
+
+    // A reservation that ends up entirely unused, followed by a used one.
+    auto unused = ring.reserve(2);
+    ring.commit(unused, 0);
+    const int items[] = {20};
+    ASSERT_TRUE(ring.push(items, 1));
+
+    int* first;
+    ASSERT_EQ(ring.peek(8, &first), 2u);
+    EXPECT_EQ(first[0], 10);
+    EXPECT_EQ(first[1], 11);
+    ring.consume(2);
+    EXPECT_EQ(drain(ring), std::vector<int>({20}));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(EventRingTest, PeeksAWrappedBacklogInTwoRuns) {
+    EventRing<int> ring(4);
+    const int items[] = {1, 2, 3};
+    ASSERT_TRUE(ring.push(items, 3));
+    EXPECT_EQ(drain(ring).size(), 3u);
+
+    const int wrapped[] = {4, 5, 6};
+    ASSERT_TRUE(ring.push(wrapped, 3));
+    int* first;
+    ASSERT_EQ(ring.peek(4, &first), 1u);
+    EXPECT_EQ(first[0], 4);
+    ring.consume(1);
+    ASSERT_EQ(ring.peek(4, &first), 2u);
+    EXPECT_EQ(first[0], 5);
+    EXPECT_EQ(first[1], 6);
+    ring.consume(2);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(EventRingTest, SkipsUnusedSlotsAcrossTheWrap) {
+    EventRing<int> ring(4);
+    const int items[] = {1, 2, 3};
+    ASSERT_TRUE(ring.push(items, 3));
+    drain(ring);
+
+    auto reservation = ring.reserve(3);
+    ring.slot(reservation, 0) = 7;
+    ring.commit(reservation, 1);
+    ASSERT_TRUE(ring.push(items, 1));
+    EXPECT_EQ(drain(ring), std::vector<int>({7, 1}));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(EventRingTest, ReportsWhetherTheHeadIsCommitted) {
+    EventRing<int> ring(8);
+    EXPECT_FALSE(ring.isHeadCommitted());
+
+    auto first = ring.reserve(1);
+    auto second = ring.reserve(1);
+    ring.slot(second, 0) = 2;
+    ring.commit(second, 1);
+    // The oldest reservation is still being filled in, nothing can be read past it.
+    EXPECT_FALSE(ring.isHeadCommitted());
+    int* items;
+    EXPECT_EQ(ring.peek(8, &items), 0u);
+
+    // Committed unused still lets peek() make progress.
+    ring.commit(first, 0);
+    EXPECT_TRUE(ring.isHeadCommitted());
+    ASSERT_EQ(ring.peek(8, &items), 1u);
+    EXPECT_EQ(items[0], 2);
+    ring.consume(1);
+    EXPECT_FALSE(ring.isHeadCommitted());
+}
+
+TEST(EventRingTest, ClearDropsEverything) {
+    EventRing<int> ring(4);
+    const int items[] = {1, 2, 3};
+    ASSERT_TRUE(ring.push(items, 3));
+    ring.clear();
+    EXPECT_TRUE(ring.empty());
+    ASSERT_TRUE(ring.push(items, 2));
+    EXPECT_EQ(drain(ring), std::vector<int>({1, 2}));
+}
+
+// Producers reserving runs of different sizes and leaving part of them unused, while a single
+// consumer drains. Every used item must arrive exactly once and in the order of its producer.
+TEST(EventRingTest, StressConcurrentProducers) {
+    constexpr int kNumProducers = 4;
+    constexpr int kItemsPerProducer = 50000;
+    EventRing<int> ring(64);
+    std::atomic<int> numDone = 0;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kNumProducers; p++) {
+        producers.emplace_back([&, p] {
+            int next = 0;
+            for (size_t i = 0; next < kItemsPerProducer; i++) {
+                size_t count = 1 + i % 5;
+                auto reservation = ring.reserve(count);
+                if (!reservation) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // Use all of the run, part of it or none of it.
+                size_t used = std::min<size_t>((i + p) % (count + 1), kItemsPerProducer - next);
+                for (size_t j = 0; j < used; j++) {
+                    ring.slot(reservation, j) = p * kItemsPerProducer + next++;
+                }
+                ring.commit(reservation, used);
+            }
+            numDone++;
+        });
+    }
+
+    std::vector<int> nextExpected(kNumProducers, 0);
+    size_t numRead = 0;
+    bool inOrder = true;
+    while (numDone < kNumProducers || !ring.empty()) {
+        int* items;
+        size_t count = ring.peek(ring.capacity(), &items);
+        if (count == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            int producer = items[i] / kItemsPerProducer;
+            inOrder &= items[i] % kItemsPerProducer == nextExpected[producer]++;
+        }
+        ring.consume(count);
+        numRead += count;
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(numRead, static_cast<size_t>(kNumProducers * kItemsPerProducer));
+    for (int p = 0; p < kNumProducers; p++) {
+        EXPECT_EQ(nextExpected[p], kItemsPerProducer);
+    }
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "HalProxyCallback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Stands in for HalProxy in tests: events that make it through the sub-HAL callback end up in a
+ * fake FMQ instead of the event queue of the framework.
+ */
+class FakeHalProxy : public V2_0::implementation::ISubHalCallback,
+                     public V2_0::implementation::IScopedWakelockRefCounter {
+  public:
+    static constexpr auto kEventTimeout = std::chrono::seconds(5);
+
+    void postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
+                                  V2_0::implementation::ScopedWakelock /* wakelock */) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.insert(mEvents.end(), events.begin(), events.end());
+        mNumWakeupEvents += numWakeupEvents;
+        mEventsCV.notify_all();
+    }
+
+    const SensorInfo& getSensorInfo(int32_t /* sensorHandle */) override { return mSensorInfo; }
+
+    bool areThreadsRunning() override { return true; }
+
+    Return<void> onDynamicSensorsConnected(const hidl_vec<SensorInfo>& /* dynamicSensorsAdded */,
+                                           int32_t /* subHalIndex */) override {
+        return Return<void>();
+    }
+
+    Return<void> onDynamicSensorsDisconnected(
+            const hidl_vec<int32_t>& /* dynamicSensorHandlesRemoved */,
+            int32_t /* subHalIndex */) override {
+        return Return<void>();
+    }
+
+    bool incrementRefCountAndMaybeAcquireWakelock(size_t delta,
+                                                  int64_t* timeoutStart = nullptr) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWakelockRefCount += delta;
+        if (timeoutStart != nullptr) {
+            *timeoutStart = 0;
+        }
+        return true;
+    }
+
+    void decrementRefCountAndMaybeReleaseWakelock(size_t delta,
+                                                  int64_t /* timeoutStart */ = -1) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWakelockRefCount -= std::min(delta, mWakelockRefCount);
+    }
+
+    /**
+     * @return The events in the fake FMQ once there are at least count of them.
+     */
+    std::vector<Event> waitForEvents(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mEventsCV.wait_for(lock, kEventTimeout, [&] { return mEvents.size() >= count; });
+        return mEvents;
+    }
+
+    size_t getNumWakeupEvents() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNumWakeupEvents;
+    }
+
+    size_t getWakelockRefCount() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWakelockRefCount;
+    }
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mEventsCV;
+    std::vector<Event> mEvents;
+    size_t mNumWakeupEvents = 0;
+    size_t mWakelockRefCount = 0;
+    SensorInfo mSensorInfo;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "HalProxyCallback.h"
+
+#include "FakeHalProxy.h"
+#include "HalProxyState.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V2_0::implementation::HalProxyCallbackV2_1;
+
+// Not used by the other tests, which share the registry and the backlog.
+constexpr int32_t kSubHalIndex = 2;
+constexpr int32_t kBitsAfterSubHalIndex = 24;
+
+constexpr int32_t kWakeupHandle = 1;
+// Only forwards events with a value of 1, like the pickup and tilt detectors.
+constexpr int32_t kFilteredHandle = 2;
+constexpr int32_t kAccelHandle = 3;
+
+int32_t getProxyHandle(int32_t localHandle) {
+    return localHandle | (kSubHalIndex << kBitsAfterSubHalIndex);
+}
+
+Event makeEvent(int32_t localHandle, float value) {
+    Event event = {};
+    event.sensorHandle = localHandle;
+    event.sensorType = SensorType::ACCELEROMETER;
+    event.u.scalar = value;
+    return event;
+}
+
+class HalProxyCallbackTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        HalProxyState& state = getHalProxyState();
+        state.setNumSubHals(kSubHalIndex + 1);
+        addSensor(kWakeupHandle, static_cast<uint32_t>(SensorFlagBits::WAKE_UP));
+        SensorEntry& filtered = addSensor(kFilteredHandle, 0);
+        filtered.actions.hasValueFilter = true;
+        filtered.actions.filterValue = 1;
+        addSensor(kAccelHandle, 0);
+        state.clearPendingWrites();
+        mCallback = new HalProxyCallbackV2_1(&mHalProxy, &mHalProxy, kSubHalIndex);
+    }
+
+    void TearDown() override { getHalProxyState().clearPendingWrites(); }
+
+    SensorEntry& addSensor(int32_t localHandle, uint32_t flags) {
+        SensorInfo sensor = {};
+        sensor.sensorHandle = getProxyHandle(localHandle);
+        sensor.type = SensorType::ACCELEROMETER;
+        sensor.flags = flags;
+        return getHalProxyState().sensorRegistry.addSensor(sensor);
+    }
+
+    /**
+     * @return The events queued in a lane, which the caller must not add to meanwhile.
+     */
+    std::vector<Event> peekLane(size_t laneIndex) {
+        EventRing<Event>& ring = getHalProxyState().pendingWrites[laneIndex].events;
+        Event* events;
+        size_t count = ring.peek(ring.capacity(), &events);
+        return std::vector<Event>(events, events + count);
+    }
+
+    FakeHalProxy mHalProxy;
+    sp<HalProxyCallbackV2_1> mCallback;
+};
+
+TEST_F(HalProxyCallbackTest, PostsProcessedEventsWakeupFirst) {
+    mCallback->postEvents({makeEvent(kAccelHandle, 9), makeEvent(kFilteredHandle, 0),
+                           makeEvent(kWakeupHandle, 1), makeEvent(kFilteredHandle, 1)},
+                          mCallback->createScopedWakelock(true));
+
+    std::vector<Event> events = mHalProxy.waitForEvents(3);
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_EQ(mHalProxy.getNumWakeupEvents(), 1u);
+    EXPECT_EQ(events[0].sensorHandle, getProxyHandle(kWakeupHandle));
+    EXPECT_EQ(events[1].sensorHandle, getProxyHandle(kAccelHandle));
+    EXPECT_EQ(events[2].sensorHandle, getProxyHandle(kFilteredHandle));
+    EXPECT_EQ(events[2].u.scalar, 1);
+}
+
+// While the FMQ is backed up, a batch goes straight to the backlog. Only the events that survive
+// processing may take slots there: slots reserved while processing would hold back the pending
+// writes thread for every sub-HAL until the batch is done.
+TEST_F(HalProxyCallbackTest, ReservesBacklogSlotsOnlyForSurvivingEvents) {
+    HalProxyState& state = getHalProxyState();
+    Event backlogged = makeEvent(kAccelHandle, 0);
+    backlogged.sensorHandle = getProxyHandle(kAccelHandle);
+    ASSERT_EQ(state.queuePendingWrites(state.getSubHalLaneIndex(0), &backlogged, 1), 0u);
+    uint64_t numBatchesWrittenToBacklog = state.numBatchesWrittenToBacklog;
+
+    mCallback->postEvents({makeEvent(kWakeupHandle, 1), makeEvent(kFilteredHandle, 0),
+                           makeEvent(kFilteredHandle, 0), makeEvent(kAccelHandle, 9),
+                           makeEvent(kFilteredHandle, 0)},
+                          mCallback->createScopedWakelock(true));
+
+    EXPECT_EQ(state.numBatchesWrittenToBacklog, numBatchesWrittenToBacklog + 1);
+    EXPECT_TRUE(mHalProxy.waitForEvents(0).empty());
+    // Accounted for before the framework could see it.
+    EXPECT_EQ(mHalProxy.getWakelockRefCount(), 1u);
+
+    size_t subHalLane = state.getSubHalLaneIndex(kSubHalIndex);
+    EXPECT_EQ(state.pendingWrites[kWakeupLane].events.size(), 1u);
+    EXPECT_EQ(state.pendingWrites[subHalLane].events.size(), 1u);
+    std::vector<Event> wakeupEvents = peekLane(kWakeupLane);
+    ASSERT_EQ(wakeupEvents.size(), 1u);
+    EXPECT_EQ(wakeupEvents[0].sensorHandle, getProxyHandle(kWakeupHandle));
+    std::vector<Event> nonWakeupEvents = peekLane(subHalLane);
+    ASSERT_EQ(nonWakeupEvents.size(), 1u);
+    EXPECT_EQ(nonWakeupEvents[0].sensorHandle, getProxyHandle(kAccelHandle));
+    EXPECT_EQ(nonWakeupEvents[0].u.scalar, 9);
+}
+
+TEST_F(HalProxyCallbackTest, DropsBatchesWithoutSurvivors) {
+    HalProxyState& state = getHalProxyState();
+    Event backlogged = makeEvent(kAccelHandle, 0);
+    backlogged.sensorHandle = getProxyHandle(kAccelHandle);
+    ASSERT_EQ(state.queuePendingWrites(state.getSubHalLaneIndex(0), &backlogged, 1), 0u);
+
+    mCallback->postEvents({makeEvent(kFilteredHandle, 0), makeEvent(kFilteredHandle, 2)},
+                          mCallback->createScopedWakelock(false));
+
+    EXPECT_TRUE(mHalProxy.waitForEvents(0).empty());
+    EXPECT_TRUE(state.pendingWrites[kWakeupLane].events.empty());
+    EXPECT_TRUE(state.pendingWrites[state.getSubHalLaneIndex(kSubHalIndex)].events.empty());
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
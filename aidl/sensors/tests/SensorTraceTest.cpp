@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorTrace.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+
+SensorInfo makeSensor(int32_t sensorHandle, SensorType type, const std::string& name) {
+    SensorInfo sensor = {};
+    sensor.sensorHandle = sensorHandle;
+    sensor.name = name;
+    sensor.type = type;
+    sensor.typeAsString = "android.sensor." + name;
+    sensor.flags = static_cast<uint32_t>(SensorFlagBits::ON_CHANGE_MODE);
+    sensor.minDelay = 5000;
+    sensor.maxDelay = 1000000;
+    sensor.fifoReservedEventCount = 10;
+    sensor.fifoMaxEventCount = 300;
+    sensor.maxRange = 78.5f;
+    sensor.resolution = 0.01f;
+    sensor.power = 0.2f;
+    return sensor;
+}
+
+Event makeEvent(int32_t sensorHandle, int64_t timestamp, float value) {
+    Event event = {};
+    event.timestamp = timestamp;
+    event.sensorHandle = sensorHandle;
+    event.sensorType = SensorType::ACCELEROMETER;
+    event.u.data[0] = value;
+    event.u.data[1] = -value;
+    return event;
+}
+
+class SensorTraceTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        char path[] = "/tmp/SensorTraceTest.XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        mPath = path;
+    }
+
+    void TearDown() override { unlink(mPath.c_str()); }
+
+    /**
+     * Record two sensors and two batches.
+     */
+    void record() {
+        std::map<int32_t, SensorInfo> sensors;
+        sensors[1] = makeSensor(1, SensorType::ACCELEROMETER, "accelerometer");
+        sensors[0x1000002] = makeSensor(0x1000002, SensorType::LIGHT, "light");
+        TraceRecorder recorder;
+        ASSERT_TRUE(recorder.start(mPath, sensors));
+        EXPECT_TRUE(recorder.isRecording());
+        recorder.recordBatch(0, {makeEvent(1, 100, 1.5f), makeEvent(1, 200, 2.5f)},
+                             false /* wakelockLocked */, 0);
+        recorder.recordBatch(1, {makeEvent(2, 300, 300)}, true /* wakelockLocked */, 3);
+        recorder.stop();
+        EXPECT_FALSE(recorder.isRecording());
+    }
+
+    std::string readFile() {
+        std::ifstream stream(mPath, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(stream), {});
+    }
+
+    void writeFile(const std::string& contents) {
+        std::ofstream stream(mPath, std::ios::binary | std::ios::trunc);
+        stream << contents;
+    }
+
+    template <typename T>
+    void appendRecord(std::string* contents, TraceRecordType type, const T& data,
+                      uint32_t size = sizeof(T)) {
+        TraceRecordHeader header = {.type = type, .size = size};
+        contents->append(reinterpret_cast<const char*>(&header), sizeof(header));
+        contents->append(reinterpret_cast<const char*>(&data), std::min<size_t>(size, sizeof(T)));
+    }
+
+    std::string mPath;
+};
+
+TEST_F(SensorTraceTest, LoadsWhatWasRecorded) {
+    record();
+
+    Trace trace;
+    ASSERT_TRUE(trace.load(mPath));
+    EXPECT_EQ(trace.header.eventSize, sizeof(Event));
+    EXPECT_GT(trace.header.startBoottimeNs, 0);
+    EXPECT_GT(trace.header.startRealtimeNs, 0);
+
+    ASSERT_EQ(trace.sensors.size(), 2u);
+    const SensorInfo& accel = trace.sensors[0];
+    EXPECT_EQ(accel.sensorHandle, 1);
+    EXPECT_EQ(accel.name, "accelerometer");
+    EXPECT_EQ(accel.typeAsString, "android.sensor.accelerometer");
+    EXPECT_EQ(accel.type, SensorType::ACCELEROMETER);
+    EXPECT_EQ(accel.flags, static_cast<uint32_t>(SensorFlagBits::ON_CHANGE_MODE));
+    EXPECT_EQ(accel.minDelay, 5000);
+    EXPECT_EQ(accel.maxDelay, 1000000);
+    EXPECT_EQ(accel.fifoReservedEventCount, 10u);
+    EXPECT_EQ(accel.fifoMaxEventCount, 300u);
+    EXPECT_EQ(accel.maxRange, 78.5f);
+    EXPECT_EQ(accel.resolution, 0.01f);
+    EXPECT_EQ(accel.power, 0.2f);
+    EXPECT_EQ(trace.sensors[1].sensorHandle, 0x1000002);
+    EXPECT_EQ(trace.sensors[1].type, SensorType::LIGHT);
+
+    ASSERT_EQ(trace.batches.size(), 2u);
+    const Trace::Batch& first = trace.batches[0];
+    EXPECT_EQ(first.header.subHalIndex, 0);
+    EXPECT_EQ(first.header.flags, 0);
+    ASSERT_EQ(first.events.size(), 2u);
+    EXPECT_EQ(first.events[1].timestamp, 200);
+    EXPECT_EQ(first.events[1].u.data[1], -2.5f);
+    const Trace::Batch& second = trace.batches[1];
+    EXPECT_EQ(second.header.subHalIndex, 1);
+    EXPECT_EQ(second.header.flags, kTraceWakelockLocked);
+    EXPECT_EQ(second.header.wakelockRefCount, 3u);
+    EXPECT_GE(second.header.arrivalNs, first.header.arrivalNs);
+    ASSERT_EQ(second.events.size(), 1u);
+    EXPECT_EQ(second.events[0].u.data[0], 300);
+}
+
+TEST_F(SensorTraceTest, KeepsTheCompleteRecordsOfATruncatedTrace) {
+    record();
+    std::string contents = readFile();
+    // Cut into the events of the last batch.
+    writeFile(contents.substr(0, contents.size() - sizeof(Event) / 2));
+
+    Trace trace;
+    ASSERT_TRUE(trace.load(mPath));
+    EXPECT_EQ(trace.sensors.size(), 2u);
+    EXPECT_EQ(trace.batches.size(), 1u);
+}
+
+TEST_F(SensorTraceTest, RejectsForeignFiles) {
+    Trace trace;
+    EXPECT_FALSE(trace.load(mPath + ".missing"));
+    // Empty.
+    EXPECT_FALSE(trace.load(mPath));
+
+    record();
+    std::string contents = readFile();
+    std::string corrupted = contents;
+    corrupted[0] = 'X';
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+
+    corrupted = contents;
+    TraceFileHeader header;
+    memcpy(&header, corrupted.data(), sizeof(header));
+    header.version = kTraceVersion + 1;
+    memcpy(corrupted.data(), &header, sizeof(header));
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+
+    corrupted = contents;
+    header.version = kTraceVersion;
+    header.eventSize = sizeof(Event) + 8;
+    memcpy(corrupted.data(), &header, sizeof(header));
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+}
+
+TEST_F(SensorTraceTest, RejectsRecordsOfTheWrongSize) {
+    record();
+    std::string contents = readFile();
+
+    // A batch that claims more events than its record holds.
+    TraceBatch batch = {.numEvents = 2};
+    std::string corrupted = contents;
+    appendRecord(&corrupted, kTraceBatch, batch);
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+
+    // A batch record too small for its header.
+    corrupted = contents;
+    appendRecord(&corrupted, kTraceBatch, batch, sizeof(batch) - 4);
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+
+    // A sensor whose strings run past its record.
+    TraceSensor sensor = {.nameLength = 100};
+    corrupted = contents;
+    appendRecord(&corrupted, kTraceSensor, sensor);
+    writeFile(corrupted);
+    EXPECT_FALSE(Trace().load(mPath));
+}
+
+TEST_F(SensorTraceTest, NeverAllocatesForSizesPastTheEndOfTheFile) {
+    record();
+    std::string contents = readFile();
+    TraceBatch batch = {.numEvents = 1};
+    appendRecord(&contents, kTraceBatch, batch, UINT32_MAX);
+    writeFile(contents);
+
+    // Treated like a trace that was cut short.
+    Trace trace;
+    ASSERT_TRUE(trace.load(mPath));
+    EXPECT_EQ(trace.batches.size(), 2u);
+}
+
+TEST_F(SensorTraceTest, SkipsUnknownRecords) {
+    record();
+    std::string contents = readFile();
+    uint64_t futureData = 42;
+    appendRecord(&contents, static_cast<TraceRecordType>(99), futureData);
+    writeFile(contents);
+
+    Trace trace;
+    ASSERT_TRUE(trace.load(mPath));
+    EXPECT_EQ(trace.sensors.size(), 2u);
+    EXPECT_EQ(trace.batches.size(), 2u);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SharedWakelock.h"
+
+#include "Clock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hardware_legacy/power.h"
+
+// Stand in for libpower, so that the test never holds a real wakelock and can check that the
+// kernel wakelock is never taken twice or released while not held.
+static std::atomic<int> sNumHeld = 0;
+static std::atomic<int> sNumAcquired = 0;
+static std::atomic<int> sNumUnbalanced = 0;
+
+int acquire_wake_lock(int /* lock */, const char* /* id */) {
+    if (sNumHeld.fetch_add(1) != 0) {
+        sNumUnbalanced++;
+    }
+    sNumAcquired++;
+    return 0;
+}
+
+int release_wake_lock(const char* /* id */) {
+    if (sNumHeld.fetch_sub(1) != 1) {
+        sNumUnbalanced++;
+    }
+    return 0;
+}
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+namespace {
+
+constexpr int64_t kTimeoutNs = 1000 * kNsPerMs;
+
+class SharedWakelockTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        sNumHeld = 0;
+        sNumAcquired = 0;
+        sNumUnbalanced = 0;
+        mWakelock.init("SharedWakelockTest", kTimeoutNs);
+    }
+
+    SharedWakelock mWakelock;
+};
+
+TEST_F(SharedWakelockTest, AcquiresOnFirstAndReleasesOnLastReference) {
+    int64_t start = mWakelock.acquire(2);
+    EXPECT_EQ(sNumHeld, 1);
+    mWakelock.acquire(1);
+    EXPECT_EQ(sNumAcquired, 1);
+
+    mWakelock.release(2, start);
+    EXPECT_EQ(mWakelock.getRefCount(), 1);
+    EXPECT_EQ(sNumHeld, 1);
+    mWakelock.release(1);
+    EXPECT_EQ(mWakelock.getRefCount(), 0);
+    EXPECT_EQ(sNumHeld, 0);
+}
+
+TEST_F(SharedWakelockTest, ReleasingTooMuchClampsToZero) {
+    mWakelock.acquire(1);
+    mWakelock.release(3);
+    EXPECT_EQ(mWakelock.getRefCount(), 0);
+    EXPECT_EQ(sNumHeld, 0);
+    EXPECT_EQ(sNumUnbalanced, 0);
+}
+
+TEST_F(SharedWakelockTest, IgnoresReleasesOfReferencesTakenBeforeReset) {
+    int64_t start = mWakelock.acquire(2);
+    mWakelock.reset();
+    EXPECT_EQ(sNumHeld, 0);
+
+    // Make sure the new references get a later timeout start than the reset.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    mWakelock.acquire(1);
+    mWakelock.release(2, start);
+    EXPECT_EQ(mWakelock.getRefCount(), 1);
+    EXPECT_EQ(sNumHeld, 1);
+}
+
+TEST_F(SharedWakelockTest, TimesOutUnlessReferencesAreTaken) {
+    SharedWakelock wakelock;
+    constexpr int64_t kShortTimeoutNs = 50 * kNsPerMs;
+    wakelock.init("SharedWakelockTest", kShortTimeoutNs);
+
+    wakelock.acquire(1);
+    int64_t timeLeftNs = 0;
+    EXPECT_FALSE(wakelock.didTimeout(&timeLeftNs));
+    EXPECT_GT(timeLeftNs, 0);
+    EXPECT_LE(timeLeftNs, kShortTimeoutNs);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    wakelock.acquire(1);
+    EXPECT_FALSE(wakelock.didTimeout(&timeLeftNs));
+    EXPECT_GT(timeLeftNs, 30 * kNsPerMs);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_TRUE(wakelock.didTimeout(&timeLeftNs));
+    wakelock.reset();
+}
+
+// Many sub-HAL callback threads taking and dropping references while the count keeps crossing
+// zero. The kernel wakelock must follow the count without ever being taken twice.
+TEST_F(SharedWakelockTest, StressConcurrentPosters) {
+    constexpr int kNumThreads = 16;
+    constexpr int kIterations = 20000;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([&, t] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < kIterations; i++) {
+                size_t delta = 1 + (i + t) % 3;
+                int64_t start = mWakelock.acquire(delta);
+                // Wake up events are acknowledged by the framework in pieces.
+                mWakelock.release(delta - 1, start);
+                mWakelock.release(1, start);
+            }
+        });
+    }
+    go = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(mWakelock.getRefCount(), 0);
+    EXPECT_EQ(sNumHeld, 0);
+    EXPECT_EQ(sNumUnbalanced, 0);
+    EXPECT_GE(sNumAcquired, 1);
+    EXPECT_EQ(mWakelock.holdUs.getTotal(), static_cast<uint64_t>(sNumAcquired.load()));
+}
+
+// Threads that only ever hold references while another one resets the wakelock, like the
+// wakelock thread does on timeout.
+TEST_F(SharedWakelockTest, StressResetWhilePosting) {
+    constexpr int kNumThreads = 8;
+    constexpr int kIterations = 10000;
+    std::atomic<bool> stop = false;
+    std::thread resetter([&] {
+        while (!stop.load()) {
+            mWakelock.reset();
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < kIterations; i++) {
+                int64_t start = mWakelock.acquire(2);
+                mWakelock.release(2, start);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    stop = true;
+    resetter.join();
+    mWakelock.reset();
+
+    EXPECT_EQ(mWakelock.getRefCount(), 0);
+    EXPECT_EQ(sNumHeld, 0);
+    EXPECT_EQ(sNumUnbalanced, 0);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "TraceReplaySubHal.h"
+
+#include "FakeHalProxy.h"
+#include "HalProxyCallback.h"
+#include "HalProxyState.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+namespace {
+
+using ::android::hardware::sensors::V1_0::MetaDataEventType;
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V2_0::implementation::HalProxyCallbackV2_1;
+using ::android::hardware::sensors::V2_1::implementation::FakeHalProxy;
+using ::android::hardware::sensors::V2_1::implementation::getHalProxyState;
+using ::android::hardware::sensors::V2_1::implementation::HalProxyState;
+using ::android::hardware::sensors::V2_1::implementation::kTraceWakelockLocked;
+using ::android::hardware::sensors::V2_1::implementation::SensorEventActions;
+
+constexpr int32_t kTracedSubHalIndex = 1;
+constexpr int32_t kBitsAfterSubHalIndex = 24;
+
+// Replay handles, in the order of the traced sensor list.
+constexpr int32_t kGlanceHandle = 1;
+constexpr int32_t kLightHandle = 2;
+constexpr int32_t kAccelHandle = 3;
+
+SensorInfo makeSensor(int32_t localHandle, SensorType type, const std::string& typeAsString,
+                      uint32_t flags) {
+    SensorInfo sensor = {};
+    sensor.sensorHandle = localHandle | (kTracedSubHalIndex << kBitsAfterSubHalIndex);
+    sensor.name = typeAsString;
+    sensor.type = type;
+    sensor.typeAsString = typeAsString;
+    sensor.flags = flags;
+    return sensor;
+}
+
+Event makeEvent(int32_t localHandle, SensorType type, float value) {
+    Event event = {};
+    event.sensorHandle = localHandle;
+    event.sensorType = type;
+    event.u.scalar = value;
+    return event;
+}
+
+Trace::Batch makeBatch(int64_t arrivalNs, bool wakelockLocked, std::vector<Event> events) {
+    Trace::Batch batch;
+    batch.header = {
+            .arrivalNs = arrivalNs,
+            .wakelockRefCount = 0,
+            .numEvents = static_cast<uint32_t>(events.size()),
+            .subHalIndex = kTracedSubHalIndex,
+            .flags = static_cast<uint8_t>(wakelockLocked ? kTraceWakelockLocked : 0),
+            .reserved = 0,
+    };
+    batch.events = std::move(events);
+    return batch;
+}
+
+/**
+ * A trace as HalProxy records it: the sensor list after the built-in rules remapped the tilt and
+ * motion detectors, and the raw events the sub-HAL posted for them.
+ */
+Trace makeTrace(bool withBatches) {
+    Trace trace = {};
+    trace.sensors.push_back(makeSensor(
+            3, SensorType::GLANCE_GESTURE, "android.sensor.glance_gesture",
+            static_cast<uint32_t>(SensorFlagBits::WAKE_UP | SensorFlagBits::ONE_SHOT_MODE)));
+    trace.sensors.push_back(makeSensor(5, SensorType::LIGHT, "android.sensor.light",
+                                       static_cast<uint32_t>(SensorFlagBits::ON_CHANGE_MODE)));
+    trace.sensors.push_back(
+            makeSensor(7, SensorType::ACCELEROMETER, "android.sensor.accelerometer", 0));
+    if (!withBatches) {
+        return trace;
+    }
+
+    trace.batches.push_back(makeBatch(1000, true,
+                                      {makeEvent(3, SensorType::GLANCE_GESTURE, 1),
+                                       makeEvent(3, SensorType::GLANCE_GESTURE, 2)}));
+    Event flushComplete = makeEvent(7, SensorType::META_DATA, 0);
+    flushComplete.u.meta.what = MetaDataEventType::META_DATA_FLUSH_COMPLETE;
+    trace.batches.push_back(makeBatch(2000, false,
+                                      {makeEvent(7, SensorType::ACCELEROMETER, 9.81f),
+                                       flushComplete, makeEvent(5, SensorType::LIGHT, 300)}));
+    return trace;
+}
+
+class TraceReplaySubHalTest : public ::testing::Test {
+  protected:
+    static constexpr size_t kSubHalIndex = 0;
+
+    /**
+     * Build the sensor list of the replay sub-HAL the way HalProxy does, rules included.
+     */
+    void registerSensors(TraceReplaySubHal& subHal) {
+        HalProxyState& state = getHalProxyState();
+        state.setNumSubHals(kSubHalIndex + 1);
+        state.sensorRules.loadDefaultsIfNeeded();
+        subHal.getSensorsList_2_1([&](const auto& list) {
+            for (SensorInfo sensor : list) {
+                SensorEventActions actions;
+                ASSERT_TRUE(state.sensorRules.apply(sensor, &actions));
+                state.sensorRegistry.addSensor(sensor).actions = actions;
+                mSensors.push_back(sensor);
+                mActions.push_back(actions);
+            }
+        });
+    }
+
+    FakeHalProxy mHalProxy;
+    std::vector<SensorInfo> mSensors;
+    std::vector<SensorEventActions> mActions;
+};
+
+TEST_F(TraceReplaySubHalTest, AdvertisesRecordedSensorsAsDevicePrivateSensors) {
+    TraceReplaySubHal subHal(makeTrace(false), false /* realtime */);
+    registerSensors(subHal);
+
+    ASSERT_EQ(mSensors.size(), 3u);
+    for (size_t i = 0; i < mSensors.size(); i++) {
+        EXPECT_EQ(mSensors[i].sensorHandle, static_cast<int32_t>(i + 1));
+        EXPECT_EQ(mSensors[i].type, SensorType::DEVICE_PRIVATE_BASE);
+        // No rule matched, so none of the quirks applies a second time.
+        EXPECT_FALSE(mActions[i].hasValueFilter);
+        EXPECT_FALSE(mActions[i].needsAlsCorrection);
+        EXPECT_LT(mActions[i].nodeFd, 0);
+    }
+    EXPECT_EQ(mSensors[0].name, "Replay android.sensor.glance_gesture");
+    EXPECT_EQ(mSensors[0].typeAsString, "org.lineageos.sensor.replay.android.sensor.glance_gesture");
+    EXPECT_EQ(mSensors[0].flags,
+              static_cast<uint32_t>(SensorFlagBits::WAKE_UP | SensorFlagBits::ONE_SHOT_MODE));
+    EXPECT_EQ(mSensors[1].typeAsString, "org.lineageos.sensor.replay.android.sensor.light");
+}
+
+TEST_F(TraceReplaySubHalTest, ReplaysRecordedEventsThroughTheCallback) {
+    TraceReplaySubHal subHal(makeTrace(true), false /* realtime */);
+    registerSensors(subHal);
+    sp<HalProxyCallbackV2_1> callback =
+            new HalProxyCallbackV2_1(&mHalProxy, &mHalProxy, kSubHalIndex);
+    ASSERT_EQ(subHal.initialize(callback), Result::OK);
+
+    std::vector<Event> events = mHalProxy.waitForEvents(4);
+    ASSERT_EQ(events.size(), 4u);
+    // The glance gesture filter of the recording session does not drop the raw events again.
+    EXPECT_EQ(events[0].sensorHandle, kGlanceHandle);
+    EXPECT_EQ(events[0].u.scalar, 1);
+    EXPECT_EQ(events[1].sensorHandle, kGlanceHandle);
+    EXPECT_EQ(events[1].u.scalar, 2);
+    EXPECT_EQ(mHalProxy.getNumWakeupEvents(), 2u);
+    // The recorded flush complete event is gone.
+    EXPECT_EQ(events[2].sensorHandle, kAccelHandle);
+    EXPECT_EQ(events[3].sensorHandle, kLightHandle);
+    EXPECT_EQ(events[3].u.scalar, 300);
+    for (const Event& event : events) {
+        EXPECT_EQ(event.sensorType, SensorType::DEVICE_PRIVATE_BASE);
+    }
+}
+
+TEST_F(TraceReplaySubHalTest, FlushPostsFlushComplete) {
+    TraceReplaySubHal subHal(makeTrace(false), false /* realtime */);
+    registerSensors(subHal);
+    EXPECT_EQ(subHal.flush(kAccelHandle), Result::BAD_VALUE);
+
+    sp<HalProxyCallbackV2_1> callback =
+            new HalProxyCallbackV2_1(&mHalProxy, &mHalProxy, kSubHalIndex);
+    ASSERT_EQ(subHal.initialize(callback), Result::OK);
+
+    EXPECT_EQ(subHal.flush(kAccelHandle), Result::OK);
+    std::vector<Event> events = mHalProxy.waitForEvents(1);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].sensorHandle, kAccelHandle);
+    EXPECT_EQ(events[0].sensorType, SensorType::META_DATA);
+    EXPECT_EQ(events[0].u.meta.what, MetaDataEventType::META_DATA_FLUSH_COMPLETE);
+    EXPECT_EQ(mHalProxy.getNumWakeupEvents(), 0u);
+
+    // One-shot sensors cannot be flushed.
+    EXPECT_EQ(subHal.flush(kGlanceHandle), Result::BAD_VALUE);
+    EXPECT_EQ(subHal.flush(42), Result::BAD_VALUE);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DirectChannel.h"
+
+#include <log/log.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::SensorsEventFormatOffset;
+
+namespace {
+
+constexpr size_t offsetOf(SensorsEventFormatOffset offset) {
+    return static_cast<size_t>(offset);
+}
+
+constexpr size_t kEventSize = offsetOf(SensorsEventFormatOffset::TOTAL_LENGTH);
+constexpr size_t kDataSize =
+        offsetOf(SensorsEventFormatOffset::RESERVED) - offsetOf(SensorsEventFormatOffset::DATA);
+
+template <typename T>
+void writeField(uint8_t* record, SensorsEventFormatOffset offset, T value) {
+    memcpy(record + offsetOf(offset), &value, sizeof(value));
+}
+
+}  // anonymous namespace
+
+DirectChannel::DirectChannel(const SharedMemInfo& mem)
+    : mFd(-1), mBuffer(nullptr), mSize(mem.size), mNumSlots(mem.size / kEventSize) {
+    const native_handle_t* handle = mem.memoryHandle.getNativeHandle();
+    if (handle == nullptr || handle->numFds < 1 || mNumSlots == 0) {
+        ALOGE("invalid direct channel memory");
+        return;
+    }
+
+    // The client owns the handle, keep the memory alive on our own.
+    mFd = dup(handle->data[0]);
+    if (mFd < 0) {
+        ALOGE("failed to dup direct channel fd: %d", errno);
+        return;
+    }
+
+    void* buffer = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (buffer == MAP_FAILED) {
+        ALOGE("failed to map direct channel: %d", errno);
+        return;
+    }
+    mBuffer = static_cast<uint8_t*>(buffer);
+    memset(mBuffer, 0, mSize);
+}
+
+DirectChannel::~DirectChannel() {
+    if (mBuffer != nullptr) munmap(mBuffer, mSize);
+    if (mFd >= 0) close(mFd);
+}
+
+void DirectChannel::write(const Event& event, int32_t reportToken) {
+    uint64_t sequence = mNextSequence.fetch_add(1, std::memory_order_relaxed);
+    uint8_t* record = mBuffer + (sequence % mNumSlots) * kEventSize;
+
+    writeField(record, SensorsEventFormatOffset::SIZE_FIELD, static_cast<int32_t>(kEventSize));
+    writeField(record, SensorsEventFormatOffset::REPORT_TOKEN, reportToken);
+    writeField(record, SensorsEventFormatOffset::SENSOR_TYPE,
+               static_cast<int32_t>(event.sensorType));
+    writeField(record, SensorsEventFormatOffset::TIMESTAMP, event.timestamp);
+    memcpy(record + offsetOf(SensorsEventFormatOffset::DATA), event.u.data.data(), kDataSize);
+
+    // The counter starts at 1 and skips 0, readers treat a changed counter as a complete record.
+    uint32_t counter = static_cast<uint32_t>(sequence % UINT32_MAX) + 1;
+    auto* counterField = reinterpret_cast<uint32_t*>(
+            record + offsetOf(SensorsEventFormatOffset::ATOMIC_COUNTER));
+    __atomic_store_n(counterField, counter, __ATOMIC_RELEASE);
+}
+
+int64_t DirectChannel::getRatePeriodNs(RateLevel rate) {
+    switch (rate) {
+        case RateLevel::NORMAL:
+            return 20000000;  // 50 Hz
+        case RateLevel::FAST:
+            return 5000000;  // 200 Hz
+        case RateLevel::VERY_FAST:
+            return 1250000;  // 800 Hz
+        default:
+            return 0;
+    }
+}
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
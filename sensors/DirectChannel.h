@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+using ::android::hardware::sensors::V1_0::RateLevel;
+using ::android::hardware::sensors::V1_0::SharedMemInfo;
+using ::android::hardware::sensors::V2_1::Event;
+
+/**
+ * Direct report ring in shared memory registered by a client. ashmem and memfd regions are mapped
+ * the same way.
+ *
+ * Writers claim a slot with a single atomic increment and publish it by storing its atomic
+ * counter last, so any number of sensors can report into the same channel without locking.
+ */
+class DirectChannel {
+  public:
+    explicit DirectChannel(const SharedMemInfo& mem);
+    ~DirectChannel();
+
+    DirectChannel(const DirectChannel&) = delete;
+    DirectChannel& operator=(const DirectChannel&) = delete;
+
+    bool isValid() const { return mBuffer != nullptr; }
+
+    void write(const Event& event, int32_t reportToken);
+
+    /**
+     * @return The sampling period of a rate level, 0 for RateLevel::STOP.
+     */
+    static int64_t getRatePeriodNs(RateLevel rate);
+
+  private:
+    int mFd;
+    uint8_t* mBuffer;
+    size_t mSize;
+    size_t mNumSlots;
+
+    std::atomic<uint64_t> mNextSequence = 0;
+};
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -18,8 +18,12 @@
 
 #include <hardware/sensors.h>
 #include <log/log.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
 
 namespace {
@@ -61,55 +65,70 @@ namespace implementation {
 
 using ::android::hardware::sensors::V1_0::MetaDataEventType;
 using ::android::hardware::sensors::V1_0::OperationMode;
+using ::android::hardware::sensors::V1_0::RateLevel;
 using ::android::hardware::sensors::V1_0::Result;
 using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V1_0::SensorFlagShift;
 using ::android::hardware::sensors::V1_0::SensorStatus;
 using ::android::hardware::sensors::V2_1::Event;
 using ::android::hardware::sensors::V2_1::SensorInfo;
 using ::android::hardware::sensors::V2_1::SensorType;
 
-Sensor::Sensor(int32_t sensorHandle, ISensorsEventCallback* callback)
+Sensor::Sensor(int32_t sensorHandle, ISensorsEventCallback* callback, SensorEventLoop* eventLoop)
     : mIsEnabled(false),
       mSamplingPeriodNs(0),
       mLastSampleTimeNs(0),
+      mMaxReportLatencyNs(0),
+      mBatchStartNs(0),
       mCallback(callback),
+      mEventLoop(eventLoop),
       mMode(OperationMode::NORMAL) {
     mSensorInfo.sensorHandle = sensorHandle;
     mSensorInfo.vendor = "The LineageOS Project";
     mSensorInfo.version = 1;
     constexpr float kDefaultMaxDelayUs = 1000 * 1000;
     mSensorInfo.maxDelay = kDefaultMaxDelayUs;
-    mSensorInfo.fifoReservedEventCount = 0;
-    mSensorInfo.fifoMaxEventCount = 0;
+    // Samples are batched in software, see batchEvents().
+    constexpr uint32_t kSoftwareFifoMaxEventCount = 256;
+    mSensorInfo.fifoReservedEventCount = kSoftwareFifoMaxEventCount;
+    mSensorInfo.fifoMaxEventCount = kSoftwareFifoMaxEventCount;
     mSensorInfo.requiredPermission = "";
-    mSensorInfo.flags = 0;
-    mRunThread = std::thread(startThread, this);
+    // Samples can also be written to ashmem direct channels, at up to 200 Hz since every sensor
+    // shares a single thread.
+    mSensorInfo.flags = SensorFlagBits::DIRECT_CHANNEL_ASHMEM |
+                        (static_cast<uint32_t>(RateLevel::FAST)
+                         << static_cast<uint32_t>(SensorFlagShift::DIRECT_REPORT));
+
+    mTimerFd = timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (mTimerFd < 0) {
+        ALOGE("failed to create timer fd: %d", errno);
+        return;
+    }
+    mEventLoop->addFd(mTimerFd, EPOLLIN, [this](uint32_t /* events */) { onTimerExpired(); });
 }
 
 Sensor::~Sensor() {
-    // Ensure that lock is unlocked before calling mRunThread.join() or a
-    // deadlock will occur.
-    {
-        std::unique_lock<std::mutex> lock(mRunMutex);
-        mStopThread = true;
-        mIsEnabled = false;
-        mWaitCV.notify_all();
+    if (mTimerFd >= 0) {
+        mEventLoop->removeFd(mTimerFd);
+        close(mTimerFd);
     }
-    mRunThread.join();
 }
 
 const SensorInfo& Sensor::getSensorInfo() const {
     return mSensorInfo;
 }
 
-void Sensor::batch(int32_t samplingPeriodNs) {
+void Sensor::batch(int32_t samplingPeriodNs, int64_t maxReportLatencyNs) {
     samplingPeriodNs =
             std::clamp(samplingPeriodNs, mSensorInfo.minDelay * 1000, mSensorInfo.maxDelay * 1000);
+    maxReportLatencyNs = std::max<int64_t>(maxReportLatencyNs, 0);
 
-    if (mSamplingPeriodNs != samplingPeriodNs) {
+    std::lock_guard<std::mutex> lock(mRunMutex);
+    if (mSamplingPeriodNs != samplingPeriodNs || mMaxReportLatencyNs != maxReportLatencyNs) {
         mSamplingPeriodNs = samplingPeriodNs;
-        // Wake up the 'run' thread to check if a new event should be generated now
-        mWaitCV.notify_all();
+        mMaxReportLatencyNs = maxReportLatencyNs;
+        // Check if a new event should be generated or the batch posted now
+        updateTimer();
     }
 }
 
@@ -117,7 +136,11 @@ void Sensor::activate(bool enable) {
     std::lock_guard<std::mutex> lock(mRunMutex);
     if (mIsEnabled != enable) {
         mIsEnabled = enable;
-        mWaitCV.notify_all();
+        if (!enable) {
+            // Samples taken before the sensor was disabled are still delivered.
+            flushBatch();
+        }
+        updateTimer();
     }
 }
 
@@ -128,8 +151,11 @@ Result Sensor::flush() {
         return Result::BAD_VALUE;
     }
 
-    // Note: If a sensor supports batching, write all of the currently batched events for the sensor
-    // to the Event FMQ prior to writing the flush complete event.
+    // Write all of the currently batched events for the sensor to the Event FMQ prior to writing
+    // the flush complete event.
+    std::lock_guard<std::mutex> lock(mRunMutex);
+    flushBatch();
+
     Event ev;
     ev.sensorHandle = mSensorInfo.sensorHandle;
     ev.sensorType = SensorType::META_DATA;
@@ -140,40 +166,131 @@ Result Sensor::flush() {
     return Result::OK;
 }
 
-void Sensor::startThread(Sensor* sensor) {
-    sensor->run();
+void Sensor::onTimerExpired() {
+    uint64_t expirations;
+    read(mTimerFd, &expirations, sizeof(expirations));
+
+    std::lock_guard<std::mutex> lock(mRunMutex);
+    if (!isSampling()) {
+        return;
+    }
+
+    int64_t now = ::android::elapsedRealtimeNano();
+    int64_t samplingPeriodNs = getEffectiveSamplingPeriodNs();
+    int64_t nextSampleTime = mLastSampleTimeNs + samplingPeriodNs;
+    if (now >= nextSampleTime) {
+        // Stay on the grid of deadlines so that the rate does not drift, unless a whole period
+        // was missed, e.g. right after enabling.
+        mLastSampleTimeNs = now - nextSampleTime < samplingPeriodNs ? nextSampleTime : now;
+        std::vector<Event> events = readEvents();
+        writeDirectReports(events);
+        if (mIsEnabled) {
+            batchEvents(events, now);
+        }
+    }
+    if (!mBatch.empty() && now >= mBatchStartNs + mMaxReportLatencyNs) {
+        flushBatch();
+    }
+
+    updateTimer();
 }
 
-void Sensor::run() {
-    std::unique_lock<std::mutex> runLock(mRunMutex);
+void Sensor::updateTimer() {
     constexpr int64_t kNanosecondsInSeconds = 1000 * 1000 * 1000;
 
-    while (!mStopThread) {
-        if (!mIsEnabled || mMode == OperationMode::DATA_INJECTION) {
-            mWaitCV.wait(runLock, [&] {
-                return ((mIsEnabled && mMode == OperationMode::NORMAL) || mStopThread);
-            });
-        } else {
-            timespec curTime;
-            clock_gettime(CLOCK_REALTIME, &curTime);
-            int64_t now = (curTime.tv_sec * kNanosecondsInSeconds) + curTime.tv_nsec;
-            int64_t nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-
-            if (now >= nextSampleTime) {
-                mLastSampleTimeNs = now;
-                nextSampleTime = mLastSampleTimeNs + mSamplingPeriodNs;
-                mCallback->postEvents(readEvents(), isWakeUpSensor());
-            }
+    struct itimerspec spec = {};
+    if (isSampling()) {
+        int64_t deadline = mLastSampleTimeNs + getEffectiveSamplingPeriodNs();
+        if (!mBatch.empty()) {
+            deadline = std::min(deadline, mBatchStartNs + mMaxReportLatencyNs);
+        }
+        // A zero deadline would disarm the timer, one in the past expires right away.
+        deadline = std::max<int64_t>(deadline, 1);
+        spec.it_value.tv_sec = deadline / kNanosecondsInSeconds;
+        spec.it_value.tv_nsec = deadline % kNanosecondsInSeconds;
+    }
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        ALOGE("failed to set timer: %d", errno);
+    }
+}
+
+bool Sensor::isSampling() const {
+    return (mIsEnabled || !mDirectReports.empty()) && mMode == OperationMode::NORMAL;
+}
+
+int64_t Sensor::getEffectiveSamplingPeriodNs() const {
+    int64_t samplingPeriodNs = mIsEnabled ? mSamplingPeriodNs : INT64_MAX;
+    for (const auto& [channelHandle, report] : mDirectReports) {
+        samplingPeriodNs = std::min(samplingPeriodNs, report.periodNs);
+    }
+    return samplingPeriodNs;
+}
 
-            mWaitCV.wait_for(runLock, std::chrono::nanoseconds(nextSampleTime - now));
+void Sensor::writeDirectReports(const std::vector<Event>& events) {
+    for (auto& [channelHandle, report] : mDirectReports) {
+        for (const Event& event : events) {
+            // Each channel gets its own rate, with some slack for timer jitter.
+            if (event.timestamp - report.lastReportNs < report.periodNs - report.periodNs / 10) {
+                continue;
+            }
+            report.channel->write(event, mSensorInfo.sensorHandle);
+            report.lastReportNs = event.timestamp;
         }
     }
 }
 
+Result Sensor::configDirectReport(int32_t channelHandle, std::shared_ptr<DirectChannel> channel,
+                                  RateLevel rate) {
+    std::lock_guard<std::mutex> lock(mRunMutex);
+    if (rate == RateLevel::STOP) {
+        mDirectReports.erase(channelHandle);
+        updateTimer();
+        return Result::OK;
+    }
+
+    uint32_t maxRate = (mSensorInfo.flags & SensorFlagBits::MASK_DIRECT_REPORT) >>
+                       static_cast<uint32_t>(SensorFlagShift::DIRECT_REPORT);
+    if (maxRate == 0 || !(mSensorInfo.flags & SensorFlagBits::DIRECT_CHANNEL_ASHMEM)) {
+        return Result::INVALID_OPERATION;
+    }
+    if (static_cast<uint32_t>(rate) > maxRate) {
+        return Result::BAD_VALUE;
+    }
+
+    int64_t periodNs =
+            std::max<int64_t>(DirectChannel::getRatePeriodNs(rate), mSensorInfo.minDelay * 1000);
+    mDirectReports[channelHandle] = {std::move(channel), periodNs, 0};
+    updateTimer();
+    return Result::OK;
+}
+
 bool Sensor::isWakeUpSensor() {
     return mSensorInfo.flags & static_cast<uint32_t>(SensorFlagBits::WAKE_UP);
 }
 
+void Sensor::batchEvents(const std::vector<Event>& events, int64_t now) {
+    if (mMaxReportLatencyNs == 0 || mSensorInfo.fifoMaxEventCount == 0) {
+        flushBatch();
+        mCallback->postEvents(events, isWakeUpSensor());
+        return;
+    }
+
+    if (mBatch.empty()) {
+        mBatchStartNs = now;
+    }
+    mBatch.insert(mBatch.end(), events.begin(), events.end());
+    if (mBatch.size() >= mSensorInfo.fifoMaxEventCount) {
+        flushBatch();
+    }
+}
+
+void Sensor::flushBatch() {
+    if (mBatch.empty()) return;
+
+    mCallback->postEvents(mBatch, isWakeUpSensor());
+    mBatch.clear();
+}
+
 std::vector<Event> Sensor::readEvents() {
     std::vector<Event> events;
     Event event;
@@ -192,7 +309,8 @@ void Sensor::setOperationMode(OperationMode mode) {
     std::lock_guard<std::mutex> lock(mRunMutex);
     if (mMode != mode) {
         mMode = mode;
-        mWaitCV.notify_all();
+        flushBatch();
+        updateTimer();
     }
 }
 
@@ -215,15 +333,22 @@ Result Sensor::injectEvent(const Event& event) {
     return result;
 }
 
-OneShotSensor::OneShotSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : Sensor(sensorHandle, callback) {
+OneShotSensor::OneShotSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                             SensorEventLoop* eventLoop)
+    : Sensor(sensorHandle, callback, eventLoop) {
     mSensorInfo.minDelay = -1;
     mSensorInfo.maxDelay = 0;
+    // One-shot sensors can neither batch nor report through direct channels.
+    mSensorInfo.fifoReservedEventCount = 0;
+    mSensorInfo.fifoMaxEventCount = 0;
+    mSensorInfo.flags &=
+            ~(SensorFlagBits::MASK_DIRECT_REPORT | SensorFlagBits::MASK_DIRECT_CHANNEL);
     mSensorInfo.flags |= SensorFlagBits::ONE_SHOT_MODE;
 }
 
-UdfpsSensor::UdfpsSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
-    : OneShotSensor(sensorHandle, callback) {
+UdfpsSensor::UdfpsSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                         SensorEventLoop* eventLoop)
+    : OneShotSensor(sensorHandle, callback, eventLoop) {
     mSensorInfo.name = "UDFPS Sensor";
     mSensorInfo.type =
             static_cast<SensorType>(static_cast<int32_t>(SensorType::DEVICE_PRIVATE_BASE) + 1);
@@ -233,38 +358,24 @@ UdfpsSensor::UdfpsSensor(int32_t sensorHandle, ISensorsEventCallback* callback)
     mSensorInfo.power = 0;
     mSensorInfo.flags |= SensorFlagBits::WAKE_UP;
 
-    int rc;
-
-    rc = pipe(mWaitPipeFd);
-    if (rc < 0) {
-        mWaitPipeFd[0] = -1;
-        mWaitPipeFd[1] = -1;
-        ALOGE("failed to open wait pipe: %d", rc);
-    }
-
     mPollFd = open("/sys/kernel/oplus_display/fp_state", O_RDONLY);
     if (mPollFd < 0) {
         ALOGE("failed to open poll fd: %d", mPollFd);
-    }
-
-    if (mWaitPipeFd[0] < 0 || mWaitPipeFd[1] < 0 || mPollFd < 0) {
-        mStopThread = true;
         return;
     }
 
-    mPolls[0] = {
-            .fd = mWaitPipeFd[0],
-            .events = POLLIN,
-    };
-
-    mPolls[1] = {
-            .fd = mPollFd,
-            .events = POLLERR | POLLPRI,
-    };
+    // Only watched while enabled, so that a change that happened meanwhile is reported as soon
+    // as the sensor is enabled again.
+    mEventLoop->addFd(
+            mPollFd, EPOLLERR | EPOLLPRI,
+            [this](uint32_t events) { onFpStateChanged(events); }, false /* enabled */);
 }
 
 UdfpsSensor::~UdfpsSensor() {
-    interruptPoll();
+    if (mPollFd >= 0) {
+        mEventLoop->removeFd(mPollFd);
+        close(mPollFd);
+    }
 }
 
 void UdfpsSensor::activate(bool enable) {
@@ -272,45 +383,19 @@ void UdfpsSensor::activate(bool enable) {
 
     if (mIsEnabled != enable) {
         mIsEnabled = enable;
-
-        interruptPoll();
-        mWaitCV.notify_all();
+        mEventLoop->setFdEnabled(mPollFd, enable);
     }
 }
 
-void UdfpsSensor::setOperationMode(OperationMode mode) {
-    Sensor::setOperationMode(mode);
-    interruptPoll();
-}
-
-void UdfpsSensor::run() {
-    std::unique_lock<std::mutex> runLock(mRunMutex);
-
-    while (!mStopThread) {
-        if (!mIsEnabled || mMode == OperationMode::DATA_INJECTION) {
-            mWaitCV.wait(runLock, [&] {
-                return ((mIsEnabled && mMode == OperationMode::NORMAL) || mStopThread);
-            });
-        } else {
-            // Cannot hold lock while polling.
-            runLock.unlock();
-            int rc = poll(mPolls, 2, -1);
-            runLock.lock();
-
-            if (rc < 0) {
-                ALOGE("failed to poll: %d", rc);
-                mStopThread = true;
-                continue;
-            }
+void UdfpsSensor::onFpStateChanged(uint32_t events) {
+    std::lock_guard<std::mutex> lock(mRunMutex);
 
-            if (mPolls[1].revents == mPolls[1].events && readFpState(mPollFd, mScreenX, mScreenY)) {
-                mIsEnabled = false;
-                mCallback->postEvents(readEvents(), isWakeUpSensor());
-            } else if (mPolls[0].revents == mPolls[0].events) {
-                char buf;
-                read(mWaitPipeFd[0], &buf, sizeof(buf));
-            }
-        }
+    // Reading the node also re-arms the notification.
+    bool pressed = readFpState(mPollFd, mScreenX, mScreenY);
+    if ((events & EPOLLPRI) && pressed && mIsEnabled && mMode == OperationMode::NORMAL) {
+        mIsEnabled = false;
+        mEventLoop->setFdEnabled(mPollFd, false);
+        mCallback->postEvents(readEvents(), isWakeUpSensor());
     }
 }
 
@@ -326,13 +411,6 @@ std::vector<Event> UdfpsSensor::readEvents() {
     return events;
 }
 
-void UdfpsSensor::interruptPoll() {
-    if (mWaitPipeFd[1] < 0) return;
-
-    char c = '1';
-    write(mWaitPipeFd[1], &c, sizeof(c));
-}
-
 }  // namespace implementation
 }  // namespace subhal
 }  // namespace V2_1
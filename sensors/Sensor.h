@@ -18,16 +18,18 @@
 
 #include <android/hardware/sensors/2.1/types.h>
 #include <fcntl.h>
-#include <poll.h>
 #include <unistd.h>
 
-#include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <thread>
 #include <vector>
 
+#include "DirectChannel.h"
+#include "SensorEventLoop.h"
+
 using ::android::hardware::sensors::V1_0::OperationMode;
+using ::android::hardware::sensors::V1_0::RateLevel;
 using ::android::hardware::sensors::V1_0::Result;
 using ::android::hardware::sensors::V2_1::Event;
 using ::android::hardware::sensors::V2_1::SensorInfo;
@@ -48,11 +50,11 @@ class ISensorsEventCallback {
 
 class Sensor {
   public:
-    Sensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    Sensor(int32_t sensorHandle, ISensorsEventCallback* callback, SensorEventLoop* eventLoop);
     virtual ~Sensor();
 
     const SensorInfo& getSensorInfo() const;
-    virtual void batch(int32_t samplingPeriodNs);
+    virtual void batch(int32_t samplingPeriodNs, int64_t maxReportLatencyNs);
     virtual void activate(bool enable);
     virtual Result flush();
 
@@ -60,54 +62,96 @@ class Sensor {
     bool supportsDataInjection() const;
     Result injectEvent(const Event& event);
 
+    /**
+     * Start, change or stop (RateLevel::STOP) writing samples to a direct channel. The report
+     * token is the sensor handle.
+     */
+    Result configDirectReport(int32_t channelHandle, std::shared_ptr<DirectChannel> channel,
+                              RateLevel rate);
+
   protected:
-    virtual void run();
+    struct DirectReport {
+        std::shared_ptr<DirectChannel> channel;
+        int64_t periodNs;
+        int64_t lastReportNs;
+    };
+
     virtual std::vector<Event> readEvents();
-    static void startThread(Sensor* sensor);
+
+    // Whether samples are taken, for the FMQ or for a direct channel. Called with mRunMutex held.
+    bool isSampling() const;
+    // Fastest period asked for by the framework or by a direct channel. Called with mRunMutex
+    // held.
+    int64_t getEffectiveSamplingPeriodNs() const;
+    void writeDirectReports(const std::vector<Event>& events);
+
+    // Called on the event loop thread when the sample timer expires.
+    void onTimerExpired();
+    // Arm the sample timer for the next sample or batch deadline, or disarm it. Called with
+    // mRunMutex held.
+    virtual void updateTimer();
 
     bool isWakeUpSensor();
 
+    // Post events right away or hold them back for up to mMaxReportLatencyNs. Called with
+    // mRunMutex held.
+    void batchEvents(const std::vector<Event>& events, int64_t now);
+    void flushBatch();
+
     bool mIsEnabled;
     int64_t mSamplingPeriodNs;
+    // CLOCK_BOOTTIME, like the event timestamps.
     int64_t mLastSampleTimeNs;
     SensorInfo mSensorInfo;
 
-    std::atomic_bool mStopThread;
-    std::condition_variable mWaitCV;
+    // Software FIFO, guarded by mRunMutex.
+    int64_t mMaxReportLatencyNs;
+    int64_t mBatchStartNs;
+    std::vector<Event> mBatch;
+
+    // Direct reports by channel handle, guarded by mRunMutex.
+    std::map<int32_t, DirectReport> mDirectReports;
+
+    // Guards the sensor state against the event loop thread.
     std::mutex mRunMutex;
-    std::thread mRunThread;
+    // Absolute CLOCK_BOOTTIME timerfd driving periodic sampling.
+    int mTimerFd;
 
     ISensorsEventCallback* mCallback;
+    SensorEventLoop* mEventLoop;
 
     OperationMode mMode;
 };
 
 class OneShotSensor : public Sensor {
   public:
-    OneShotSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    OneShotSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                  SensorEventLoop* eventLoop);
 
-    virtual void batch(int32_t /* samplingPeriodNs */) override {}
+    virtual void batch(int32_t /* samplingPeriodNs */, int64_t /* maxReportLatencyNs */) override {}
 
     virtual Result flush() override { return Result::BAD_VALUE; }
+
+  protected:
+    // One-shot sensors report on their own, never on a timer.
+    virtual void updateTimer() override {}
 };
 
 class UdfpsSensor : public OneShotSensor {
   public:
-    UdfpsSensor(int32_t sensorHandle, ISensorsEventCallback* callback);
+    UdfpsSensor(int32_t sensorHandle, ISensorsEventCallback* callback,
+                SensorEventLoop* eventLoop);
     virtual ~UdfpsSensor() override;
 
     virtual void activate(bool enable) override;
-    virtual void setOperationMode(OperationMode mode) override;
 
   protected:
-    virtual void run() override;
     virtual std::vector<Event> readEvents();
 
   private:
-    void interruptPoll();
+    // Called on the event loop thread when fp_state changes.
+    void onFpStateChanged(uint32_t events);
 
-    struct pollfd mPolls[2];
-    int mWaitPipeFd[2];
     int mPollFd;
 
     int mScreenX;
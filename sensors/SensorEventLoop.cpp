@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorEventLoop.h"
+
+#include <log/log.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+SensorEventLoop::SensorEventLoop() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        ALOGE("failed to create epoll fd: %d", errno);
+    }
+
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeFd < 0) {
+        ALOGE("failed to create wake fd: %d", errno);
+        return;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data = {.ptr = nullptr}};
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event) < 0) {
+        ALOGE("failed to watch wake fd: %d", errno);
+    }
+}
+
+SensorEventLoop::~SensorEventLoop() {
+    stop();
+    if (mWakeFd >= 0) close(mWakeFd);
+    if (mEpollFd >= 0) close(mEpollFd);
+}
+
+void SensorEventLoop::start() {
+    if (mThread.joinable()) return;
+
+    mStopThread = false;
+    mThread = std::thread([this] { run(); });
+}
+
+void SensorEventLoop::stop() {
+    if (!mThread.joinable()) return;
+
+    mStopThread = true;
+    uint64_t value = 1;
+    write(mWakeFd, &value, sizeof(value));
+    mThread.join();
+}
+
+bool SensorEventLoop::addFd(int fd, uint32_t events, Handler handler, bool enabled) {
+    std::lock_guard<std::mutex> lock(mWatchesMutex);
+    auto watch = std::make_unique<Watch>(Watch{fd, events, std::move(handler), false});
+    Watch* watchPtr = watch.get();
+    mWatches[fd] = std::move(watch);
+
+    if (enabled) {
+        struct epoll_event event = {.events = events, .data = {.ptr = watchPtr}};
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ALOGE("failed to watch fd %d: %d", fd, errno);
+            mWatches.erase(fd);
+            return false;
+        }
+        watchPtr->enabled = true;
+    }
+    return true;
+}
+
+void SensorEventLoop::removeFd(int fd) {
+    std::lock_guard<std::mutex> lock(mWatchesMutex);
+    auto watch = mWatches.find(fd);
+    if (watch == mWatches.end()) return;
+
+    if (watch->second->enabled) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    mWatches.erase(watch);
+}
+
+void SensorEventLoop::setFdEnabled(int fd, bool enabled) {
+    std::lock_guard<std::mutex> lock(mWatchesMutex);
+    auto watch = mWatches.find(fd);
+    if (watch == mWatches.end() || watch->second->enabled == enabled) return;
+
+    Watch* watchPtr = watch->second.get();
+    int rc;
+    if (enabled) {
+        struct epoll_event event = {.events = watchPtr->events, .data = {.ptr = watchPtr}};
+        rc = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event);
+    } else {
+        rc = epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    if (rc < 0) {
+        ALOGE("failed to %s fd %d: %d", enabled ? "watch" : "unwatch", fd, errno);
+        return;
+    }
+    watchPtr->enabled = enabled;
+}
+
+void SensorEventLoop::run() {
+    constexpr int kMaxEvents = 16;
+    struct epoll_event events[kMaxEvents];
+
+    while (!mStopThread) {
+        int count = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            ALOGE("failed to wait for events: %d", errno);
+            break;
+        }
+
+        for (int i = 0; i < count && !mStopThread; i++) {
+            Watch* watch = static_cast<Watch*>(events[i].data.ptr);
+            if (watch == nullptr) {
+                uint64_t value;
+                read(mWakeFd, &value, sizeof(value));
+                continue;
+            }
+            watch->handler(events[i].events);
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
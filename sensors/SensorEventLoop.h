@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+
+/**
+ * Single epoll driven thread that serves every sensor of the sub-HAL. Periodic sensors register a
+ * timerfd, sensors backed by a sysfs node register the node for POLLPRI. Handlers run on the loop
+ * thread, one at a time.
+ */
+class SensorEventLoop {
+  public:
+    using Handler = std::function<void(uint32_t events)>;
+
+    SensorEventLoop();
+    ~SensorEventLoop();
+
+    void start();
+    void stop();
+
+    /**
+     * Watch fd for the given epoll events.
+     *
+     * @param enabled Whether to start watching right away, see setFdEnabled().
+     */
+    bool addFd(int fd, uint32_t events, Handler handler, bool enabled = true);
+
+    /**
+     * Stop watching fd. Only safe while the loop is stopped, or from its own handler.
+     */
+    void removeFd(int fd);
+
+    /**
+     * Temporarily stop or resume watching fd. Events that are still pending on the fd are
+     * reported once it is enabled again.
+     */
+    void setFdEnabled(int fd, bool enabled);
+
+  private:
+    struct Watch {
+        int fd;
+        uint32_t events;
+        Handler handler;
+        bool enabled;
+    };
+
+    void run();
+
+    int mEpollFd;
+    // Wakes the loop so that it notices stop().
+    int mWakeFd;
+
+    std::mutex mWatchesMutex;
+    std::map<int, std::unique_ptr<Watch>> mWatches;
+
+    std::atomic_bool mStopThread = false;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
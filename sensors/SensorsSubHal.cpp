@@ -34,6 +34,12 @@ using ::android::hardware::sensors::V2_0::implementation::ScopedWakelock;
 
 SensorsSubHal::SensorsSubHal() : mCallback(nullptr), mNextHandle(1) {
     AddSensor<UdfpsSensor>();
+    mEventLoop.start();
+}
+
+SensorsSubHal::~SensorsSubHal() {
+    // Make sure no handler runs while the sensors go away.
+    mEventLoop.stop();
 }
 
 Return<void> SensorsSubHal::getSensorsList_2_1(ISensors::getSensorsList_2_1_cb _hidl_cb) {
@@ -63,10 +69,10 @@ Return<Result> SensorsSubHal::activate(int32_t sensorHandle, bool enabled) {
 }
 
 Return<Result> SensorsSubHal::batch(int32_t sensorHandle, int64_t samplingPeriodNs,
-                                    int64_t /* maxReportLatencyNs */) {
+                                    int64_t maxReportLatencyNs) {
     auto sensor = mSensors.find(sensorHandle);
     if (sensor != mSensors.end()) {
-        sensor->second->batch(samplingPeriodNs);
+        sensor->second->batch(samplingPeriodNs, maxReportLatencyNs);
         return Result::OK;
     }
     return Result::BAD_VALUE;
@@ -89,20 +95,74 @@ Return<Result> SensorsSubHal::injectSensorData_2_1(const Event& event) {
     return Result::BAD_VALUE;
 }
 
-Return<void> SensorsSubHal::registerDirectChannel(const SharedMemInfo& /* mem */,
+Return<void> SensorsSubHal::registerDirectChannel(const SharedMemInfo& mem,
                                                   ISensors::registerDirectChannel_cb _hidl_cb) {
-    _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
+    if (mem.type != SharedMemType::ASHMEM) {
+        _hidl_cb(Result::INVALID_OPERATION, -1 /* channelHandle */);
+        return Return<void>();
+    }
+    if (mem.format != SharedMemFormat::SENSORS_EVENT) {
+        _hidl_cb(Result::BAD_VALUE, -1 /* channelHandle */);
+        return Return<void>();
+    }
+
+    auto channel = std::make_shared<DirectChannel>(mem);
+    if (!channel->isValid()) {
+        _hidl_cb(Result::NO_MEMORY, -1 /* channelHandle */);
+        return Return<void>();
+    }
+
+    std::lock_guard<std::mutex> lock(mDirectChannelsMutex);
+    int32_t channelHandle = mNextChannelHandle++;
+    mDirectChannels[channelHandle] = channel;
+    _hidl_cb(Result::OK, channelHandle);
     return Return<void>();
 }
 
-Return<Result> SensorsSubHal::unregisterDirectChannel(int32_t /* channelHandle */) {
-    return Result::INVALID_OPERATION;
+Return<Result> SensorsSubHal::unregisterDirectChannel(int32_t channelHandle) {
+    std::lock_guard<std::mutex> lock(mDirectChannelsMutex);
+    if (mDirectChannels.erase(channelHandle) == 0) {
+        return Result::BAD_VALUE;
+    }
+    // Sensors drop their reference, the memory is unmapped once the last write is done.
+    for (const auto& sensor : mSensors) {
+        sensor.second->configDirectReport(channelHandle, nullptr, RateLevel::STOP);
+    }
+    return Result::OK;
 }
 
-Return<void> SensorsSubHal::configDirectReport(int32_t /* sensorHandle */,
-                                               int32_t /* channelHandle */, RateLevel /* rate */,
+Return<void> SensorsSubHal::configDirectReport(int32_t sensorHandle, int32_t channelHandle,
+                                               RateLevel rate,
                                                ISensors::configDirectReport_cb _hidl_cb) {
-    _hidl_cb(Result::INVALID_OPERATION, 0 /* reportToken */);
+    std::lock_guard<std::mutex> lock(mDirectChannelsMutex);
+    auto channel = mDirectChannels.find(channelHandle);
+    if (channel == mDirectChannels.end()) {
+        _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+        return Return<void>();
+    }
+
+    // Stop every sensor reporting to the channel.
+    if (sensorHandle == -1) {
+        if (rate != RateLevel::STOP) {
+            _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+            return Return<void>();
+        }
+        for (const auto& sensor : mSensors) {
+            sensor.second->configDirectReport(channelHandle, nullptr, RateLevel::STOP);
+        }
+        _hidl_cb(Result::OK, 0 /* reportToken */);
+        return Return<void>();
+    }
+
+    auto sensor = mSensors.find(sensorHandle);
+    if (sensor == mSensors.end()) {
+        _hidl_cb(Result::BAD_VALUE, 0 /* reportToken */);
+        return Return<void>();
+    }
+
+    Result result = sensor->second->configDirectReport(channelHandle, channel->second, rate);
+    bool started = result == Result::OK && rate != RateLevel::STOP;
+    _hidl_cb(result, started ? sensorHandle : 0 /* reportToken */);
     return Return<void>();
 }
 
@@ -128,6 +188,8 @@ Return<void> SensorsSubHal::debug(const hidl_handle& fd, const hidl_vec<hidl_str
         stream << "Name: " << info.name << std::endl;
         stream << "Min delay: " << info.minDelay << std::endl;
         stream << "Flags: " << info.flags << std::endl;
+        stream << "FIFO reserved/max event count: " << info.fifoReservedEventCount << "/"
+               << info.fifoMaxEventCount << std::endl;
     }
     stream << std::endl;
 
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "Sensor.h"
@@ -31,7 +34,9 @@ namespace implementation {
 using ::android::hardware::sensors::V1_0::OperationMode;
 using ::android::hardware::sensors::V1_0::RateLevel;
 using ::android::hardware::sensors::V1_0::Result;
+using ::android::hardware::sensors::V1_0::SharedMemFormat;
 using ::android::hardware::sensors::V1_0::SharedMemInfo;
+using ::android::hardware::sensors::V1_0::SharedMemType;
 using ::android::hardware::sensors::V2_1::Event;
 using ::android::hardware::sensors::V2_1::implementation::IHalProxyCallback;
 using ::android::hardware::sensors::V2_1::implementation::ISensorsSubHal;
@@ -39,6 +44,7 @@ using ::android::hardware::sensors::V2_1::implementation::ISensorsSubHal;
 class SensorsSubHal : public ISensorsSubHal, public ISensorsEventCallback {
   public:
     SensorsSubHal();
+    ~SensorsSubHal();
 
     Return<void> getSensorsList_2_1(ISensors::getSensorsList_2_1_cb _hidl_cb);
     Return<Result> injectSensorData_2_1(const Event& event);
@@ -72,11 +78,13 @@ class SensorsSubHal : public ISensorsSubHal, public ISensorsEventCallback {
   protected:
     template <class SensorType>
     void AddSensor() {
-        std::shared_ptr<SensorType> sensor =
-                std::make_shared<SensorType>(mNextHandle++ /* sensorHandle */, this /* callback */);
+        std::shared_ptr<SensorType> sensor = std::make_shared<SensorType>(
+                mNextHandle++ /* sensorHandle */, this /* callback */, &mEventLoop);
         mSensors[sensor->getSensorInfo().sensorHandle] = sensor;
     }
 
+    // Drives every sensor, so it has to outlive them.
+    SensorEventLoop mEventLoop;
     std::map<int32_t, std::shared_ptr<Sensor>> mSensors;
 
     sp<IHalProxyCallback> mCallback;
@@ -85,6 +93,10 @@ class SensorsSubHal : public ISensorsSubHal, public ISensorsEventCallback {
     OperationMode mCurrentOperationMode = OperationMode::NORMAL;
 
     int32_t mNextHandle;
+
+    std::mutex mDirectChannelsMutex;
+    std::map<int32_t, std::shared_ptr<DirectChannel>> mDirectChannels;
+    int32_t mNextChannelHandle = 1;
 };
 
 }  // namespace implementation
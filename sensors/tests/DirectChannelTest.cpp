@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DirectChannel.h"
+
+#include <cutils/native_handle.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace subhal {
+namespace implementation {
+namespace {
+
+using ::android::hardware::hidl_handle;
+using ::android::hardware::sensors::V1_0::SensorsEventFormatOffset;
+using ::android::hardware::sensors::V1_0::SharedMemFormat;
+using ::android::hardware::sensors::V1_0::SharedMemType;
+
+constexpr size_t kEventSize = static_cast<size_t>(SensorsEventFormatOffset::TOTAL_LENGTH);
+
+template <typename T>
+T readField(const uint8_t* record, SensorsEventFormatOffset offset) {
+    T value;
+    memcpy(&value, record + static_cast<size_t>(offset), sizeof(value));
+    return value;
+}
+
+/**
+ * A memfd backed direct channel as a client would set it up, with the client's own mapping to
+ * read back what the channel wrote.
+ */
+class MemfdChannel {
+  public:
+    explicit MemfdChannel(size_t numSlots) : mSize(numSlots * kEventSize) {
+        int fd = memfd_create("DirectChannelTest", MFD_CLOEXEC);
+        EXPECT_GE(fd, 0);
+        EXPECT_EQ(ftruncate(fd, mSize), 0);
+        mHandle = native_handle_create(1, 0);
+        mHandle->data[0] = fd;
+        void* buffer = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+        EXPECT_NE(buffer, MAP_FAILED);
+        mBuffer = static_cast<const uint8_t*>(buffer);
+    }
+
+    ~MemfdChannel() {
+        munmap(const_cast<uint8_t*>(mBuffer), mSize);
+        native_handle_close(mHandle);
+        native_handle_delete(mHandle);
+    }
+
+    SharedMemInfo getMemInfo() const {
+        return {.type = SharedMemType::ASHMEM,
+                .format = SharedMemFormat::SENSORS_EVENT,
+                .size = static_cast<uint32_t>(mSize),
+                .memoryHandle = hidl_handle(mHandle)};
+    }
+
+    const uint8_t* getRecord(size_t slot) const { return mBuffer + slot * kEventSize; }
+
+  private:
+    size_t mSize;
+    native_handle_t* mHandle;
+    const uint8_t* mBuffer;
+};
+
+Event makeEvent(int64_t timestamp, float value) {
+    Event event = {};
+    event.timestamp = timestamp;
+    event.sensorType = SensorType::ACCELEROMETER;
+    event.u.data[0] = value;
+    event.u.data[1] = -value;
+    return event;
+}
+
+TEST(DirectChannelTest, RejectsMissingOrTooSmallMemory) {
+    SharedMemInfo mem = {};
+    EXPECT_FALSE(DirectChannel(mem).isValid());
+
+    MemfdChannel client(1);
+    mem = client.getMemInfo();
+    mem.size = kEventSize - 1;
+    EXPECT_FALSE(DirectChannel(mem).isValid());
+}
+
+TEST(DirectChannelTest, WritesRecordsInSensorsEventFormat) {
+    MemfdChannel client(4);
+    DirectChannel channel(client.getMemInfo());
+    ASSERT_TRUE(channel.isValid());
+
+    channel.write(makeEvent(1000, 1.5f), 7);
+    channel.write(makeEvent(2000, 2.5f), 7);
+
+    for (size_t slot = 0; slot < 2; slot++) {
+        const uint8_t* record = client.getRecord(slot);
+        EXPECT_EQ(readField<int32_t>(record, SensorsEventFormatOffset::SIZE_FIELD),
+                  static_cast<int32_t>(kEventSize));
+        EXPECT_EQ(readField<int32_t>(record, SensorsEventFormatOffset::REPORT_TOKEN), 7);
+        EXPECT_EQ(readField<int32_t>(record, SensorsEventFormatOffset::SENSOR_TYPE),
+                  static_cast<int32_t>(SensorType::ACCELEROMETER));
+        EXPECT_EQ(readField<uint32_t>(record, SensorsEventFormatOffset::ATOMIC_COUNTER),
+                  slot + 1);
+        EXPECT_EQ(readField<int64_t>(record, SensorsEventFormatOffset::TIMESTAMP),
+                  static_cast<int64_t>(slot + 1) * 1000);
+        EXPECT_EQ(readField<float>(record, SensorsEventFormatOffset::DATA), slot + 1.5f);
+    }
+    // Untouched slots stay zeroed, so readers do not mistake them for records.
+    EXPECT_EQ(readField<uint32_t>(client.getRecord(2), SensorsEventFormatOffset::ATOMIC_COUNTER),
+              0u);
+}
+
+TEST(DirectChannelTest, WrapsAroundTheRing) {
+    MemfdChannel client(3);
+    DirectChannel channel(client.getMemInfo());
+    ASSERT_TRUE(channel.isValid());
+
+    for (int i = 0; i < 7; i++) {
+        channel.write(makeEvent(i, i), 1);
+    }
+    // The seventh record overwrote the first slot.
+    const uint8_t* record = client.getRecord(0);
+    EXPECT_EQ(readField<uint32_t>(record, SensorsEventFormatOffset::ATOMIC_COUNTER), 7u);
+    EXPECT_EQ(readField<int64_t>(record, SensorsEventFormatOffset::TIMESTAMP), 6);
+}
+
+TEST(DirectChannelTest, KeepsTheMemoryAfterTheClientClosesItsHandle) {
+    auto client = std::make_unique<MemfdChannel>(2);
+    DirectChannel channel(client->getMemInfo());
+    ASSERT_TRUE(channel.isValid());
+    client.reset();
+
+    channel.write(makeEvent(1, 1), 1);
+}
+
+TEST(DirectChannelTest, ConcurrentWritersClaimDistinctSlots) {
+    constexpr int kNumThreads = 8;
+    constexpr int kEventsPerThread = 64;
+    MemfdChannel client(kNumThreads * kEventsPerThread);
+    DirectChannel channel(client.getMemInfo());
+    ASSERT_TRUE(channel.isValid());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kEventsPerThread; i++) {
+                channel.write(makeEvent(t * kEventsPerThread + i, 0), t + 1);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::set<uint32_t> counters;
+    std::set<int64_t> timestamps;
+    for (size_t slot = 0; slot < kNumThreads * kEventsPerThread; slot++) {
+        const uint8_t* record = client.getRecord(slot);
+        counters.insert(readField<uint32_t>(record, SensorsEventFormatOffset::ATOMIC_COUNTER));
+        timestamps.insert(readField<int64_t>(record, SensorsEventFormatOffset::TIMESTAMP));
+    }
+    EXPECT_EQ(counters.size(), kNumThreads * kEventsPerThread);
+    EXPECT_EQ(counters.count(0), 0u);
+    EXPECT_EQ(timestamps.size(), kNumThreads * kEventsPerThread);
+}
+
+TEST(DirectChannelTest, MapsRateLevelsToPeriods) {
+    EXPECT_EQ(DirectChannel::getRatePeriodNs(RateLevel::STOP), 0);
+    EXPECT_EQ(DirectChannel::getRatePeriodNs(RateLevel::NORMAL), 20000000);
+    EXPECT_EQ(DirectChannel::getRatePeriodNs(RateLevel::FAST), 5000000);
+    EXPECT_EQ(DirectChannel::getRatePeriodNs(RateLevel::VERY_FAST), 1250000);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace subhal
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android